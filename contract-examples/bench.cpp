@@ -0,0 +1,2144 @@
+/*
+    Micro-benchmarks for the contract hot paths.
+
+    Build with `make bench`, run as `./bench [--json] [holders]`. `--json`
+    prints one JSON object per result instead of the aligned table, so runs
+    from different commits can be diffed. `./bench --contract` runs a single
+    contract call from stdin; the batch benchmark spawns it.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <map>
+#include <new>
+#include <random>
+#include <sstream>
+#include <unordered_map>
+
+#include <fcntl.h>
+#ifndef __EMSCRIPTEN__
+#include <spawn.h>
+#include <sys/wait.h>
+#endif
+
+#include <boost/multiprecision/cpp_int.hpp>
+
+#include "../src/versatus_cpp.hpp"
+#include "../src/versatus_cpp_erc20.hpp"
+#include "../src/versatus_cpp_parallel.hpp"
+#include "../src/versatus_cpp_concurrent.hpp"
+#include "../src/versatus_cpp_erc721.hpp"
+#include "../src/versatus_cpp_journal.hpp"
+
+// Live heap bytes and allocation count, tracked by the replacement operator new/delete below.
+// Atomic because the parallel and concurrent benches allocate from several threads.
+static std::atomic<std::size_t> g_liveBytes{0};
+static std::atomic<std::size_t> g_allocations{0};
+
+static std::size_t liveBytes() {
+    return g_liveBytes.load(std::memory_order_relaxed);
+}
+
+static std::size_t allocationCount() {
+    return g_allocations.load(std::memory_order_relaxed);
+}
+
+void* operator new(std::size_t size) {
+    auto* block = static_cast<std::size_t*>(std::malloc(size + sizeof(std::max_align_t)));
+    if (!block) throw std::bad_alloc();
+    *block = size;
+    g_liveBytes.fetch_add(size, std::memory_order_relaxed);
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    VERSATUS_STATS_COUNT(Allocations, 1);
+    return reinterpret_cast<char*>(block) + sizeof(std::max_align_t);
+}
+
+void operator delete(void* ptr) noexcept {
+    if (!ptr) return;
+    auto* block = reinterpret_cast<std::size_t*>(static_cast<char*>(ptr) - sizeof(std::max_align_t));
+    g_liveBytes.fetch_sub(*block, std::memory_order_relaxed);
+    std::free(block);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    operator delete(ptr);
+}
+
+namespace {
+
+// Keeps the optimizer from discarding benchmarked results
+template <typename T>
+void doNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+bool g_jsonOutput = false;
+
+// Prints one result; `ops` is the operation count it was averaged over, if any
+void report(const std::string& name, double value, const char* unit, std::size_t ops = 0) {
+    if (g_jsonOutput) {
+        json record = {{"name", name}, {"value", value}, {"unit", unit}};
+        if (ops) record["ops"] = ops;
+        std::printf("%s\n", record.dump().c_str());
+    } else if (ops) {
+        std::printf("%-48s %12zu ops %10.2f %s\n", name.c_str(), ops, value, unit);
+    } else {
+        std::printf("%-48s %12.2f %s\n", name.c_str(), value, unit);
+    }
+}
+
+// Runs `fn` once over `ops` operations and prints the per-operation cost
+template <typename Fn>
+void bench(const std::string& name, std::size_t ops, Fn&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    double ns = std::chrono::duration<double, std::nano>(elapsed).count();
+    report(name, ns / static_cast<double>(ops), "ns/op", ops);
+}
+
+std::vector<Address> randomAddresses(std::size_t count, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<Address> addresses(count);
+    for (auto& address : addresses) {
+        for (std::size_t i = 0; i < ADDRESS_SIZE; i += 8) {
+            uint64_t word = rng();
+            std::memcpy(address.data() + i, &word, std::min<std::size_t>(8, ADDRESS_SIZE - i));
+        }
+    }
+    return addresses;
+}
+
+// The hash ERC20 used before the flat table, kept as the baseline
+struct LegacyAddressHash {
+    size_t operator()(const Address& addr) const {
+        size_t result = 0;
+        for (const auto& byte : addr) {
+            result = (result << 8) ^ byte;
+        }
+        return result;
+    }
+};
+
+// Address sets for hash quality: random, plus sets that share long prefixes
+// or suffixes the way vanity and sequentially derived addresses do
+std::vector<Address> sharedPrefixAddresses(std::size_t count) {
+    std::vector<Address> addresses(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        addresses[i].fill(0x00);
+        uint32_t tail = static_cast<uint32_t>(i);
+        std::memcpy(addresses[i].data() + ADDRESS_SIZE - 4, &tail, 4);
+    }
+    return addresses;
+}
+
+std::vector<Address> sharedSuffixAddresses(std::size_t count) {
+    std::vector<Address> addresses(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        addresses[i].fill(0xAB);
+        uint32_t head = static_cast<uint32_t>(i);
+        std::memcpy(addresses[i].data(), &head, 4);
+    }
+    return addresses;
+}
+
+// Addresses whose middle word (bytes 8..15) is AddressHash::kP1, the family
+// that zeroes the first mixing round when only one operand carries the seed
+std::vector<Address> keyCancelAddresses(std::size_t count) {
+    std::vector<Address> addresses(count);
+    for (std::size_t i = 0; i < count; ++i) {
+        addresses[i].fill(0xAB);
+        const uint64_t head = i;
+        std::memcpy(addresses[i].data(), &head, 8);
+        std::memcpy(addresses[i].data() + 8, &AddressHash::kP1, 8);
+    }
+    return addresses;
+}
+
+// Reports how many addresses share a bucket in a power-of-two table sized
+// for the set, against the ~37% expected from an ideal random hash
+template <typename Hash>
+void benchHashQuality(const char* label, const char* set, const std::vector<Address>& addresses) {
+    std::size_t buckets = 1;
+    while (buckets < addresses.size()) buckets *= 2;
+    std::vector<uint32_t> load(buckets, 0);
+    Hash hash;
+
+    std::size_t collisions = 0;
+    std::string name = std::string("hash/") + label + "/" + set;
+    bench(name.c_str(), addresses.size(), [&] {
+        for (const auto& address : addresses) {
+            collisions += (load[hash(address) & (buckets - 1)]++ != 0);
+        }
+    });
+    report(name + "/colliding", 100.0 * static_cast<double>(collisions) / static_cast<double>(addresses.size()), "%");
+}
+
+template <typename Map>
+void benchAdversarialLookup(const char* label, const char* set, const std::vector<Address>& addresses) {
+    Map balances;
+    for (const auto& address : addresses) balances[address] = 1;
+    std::string name = std::string("hash/") + label + "/" + set + "_lookup";
+    bench(name.c_str(), addresses.size(), [&] {
+        for (const auto& address : addresses) doNotOptimize(balances.find(address)->second);
+    });
+}
+
+template <typename Map>
+void benchBalanceMap(const char* label, const std::vector<Address>& holders, const std::vector<Address>& strangers) {
+    const std::size_t n = holders.size();
+    std::string prefix = std::string("balances/") + label;
+    Map balances;
+
+    bench((prefix + "/insert").c_str(), n, [&] {
+        for (const auto& holder : holders) balances[holder] = 1000;
+    });
+
+    std::vector<std::size_t> order(n);
+    std::mt19937_64 rng(7);
+    for (auto& index : order) index = rng() % n;
+
+    bench((prefix + "/lookup_hit").c_str(), n, [&] {
+        for (auto index : order) {
+            auto it = balances.find(holders[index]);
+            doNotOptimize(it->second);
+        }
+    });
+
+    bench((prefix + "/lookup_miss").c_str(), strangers.size(), [&] {
+        std::size_t found = 0;
+        for (const auto& stranger : strangers) found += (balances.find(stranger) != balances.end());
+        doNotOptimize(found);
+    });
+
+    bench((prefix + "/transfer").c_str(), n, [&] {
+        for (std::size_t i = 0; i < n; ++i) {
+            const auto& from = holders[order[i]];
+            const auto& to = holders[order[(i + 1) % n]];
+            auto itFrom = balances.find(from);
+            if (itFrom->second < 1) continue;
+            itFrom->second -= 1;
+            balances[to] += 1;
+        }
+    });
+}
+
+using NestedAllowances = std::unordered_map<Address, std::unordered_map<Address, uint256_t, AddressHash>, AddressHash>;
+
+// The token's own allowance table. approve() always grants from _msgSender(),
+// so other owners' approvals go through applyChanges(), which writes the same
+// slot as approve() without an event; one change at a time keeps the token's
+// pending change set from growing.
+struct TokenAllowances {
+    ERC20 token{"Bench", "BNC"};
+    Erc20ChangeSet change;
+};
+
+void setAllowance(NestedAllowances& allowances, const Address& owner, const Address& spender,
+                  const uint256_t& value) {
+    allowances[owner][spender] = value;
+}
+
+void setAllowance(TokenAllowances& allowances, const Address& owner, const Address& spender,
+                  const uint256_t& value) {
+    allowances.change.clear();
+    allowances.change.record(Erc20StateChange::Slot::Allowance, owner, spender, 0, value);
+    allowances.token.applyChanges(allowances.change);
+}
+
+uint256_t allowanceOf(const NestedAllowances& allowances, const Address& owner, const Address& spender) {
+    auto itOuter = allowances.find(owner);
+    if (itOuter == allowances.end()) return 0;
+    auto itInner = itOuter->second.find(spender);
+    return (itInner != itOuter->second.end()) ? itInner->second : 0;
+}
+
+uint256_t allowanceOf(const TokenAllowances& allowances, const Address& owner, const Address& spender) {
+    return allowances.token.allowance(owner, spender);
+}
+
+// Each owner approves `spendersPerOwner` spenders; reports heap bytes per approval
+template <typename Map>
+void benchAllowances(const char* label, const std::vector<Address>& owners, const std::vector<Address>& spenders,
+                     std::size_t spendersPerOwner) {
+    const std::size_t approvals = owners.size() * spendersPerOwner;
+    std::string prefix = std::string("allowances/") + label + "/x" + std::to_string(spendersPerOwner);
+
+    std::size_t before = liveBytes();
+    Map allowances;
+    bench((prefix + "/approve").c_str(), approvals, [&] {
+        for (std::size_t i = 0; i < owners.size(); ++i) {
+            for (std::size_t k = 0; k < spendersPerOwner; ++k) {
+                setAllowance(allowances, owners[i], spenders[(i + k) % spenders.size()], 1000);
+            }
+        }
+    });
+    report(prefix + "/memory", static_cast<double>(liveBytes() - before) / static_cast<double>(approvals),
+           "bytes/approval");
+
+    std::mt19937_64 rng(11);
+    bench((prefix + "/lookup").c_str(), approvals, [&] {
+        for (std::size_t n = 0; n < approvals; ++n) {
+            std::size_t i = rng() % owners.size();
+            std::size_t k = rng() % spendersPerOwner;
+            doNotOptimize(allowanceOf(allowances, owners[i], spenders[(i + k) % spenders.size()]));
+        }
+    });
+}
+
+// ERC20::approve() itself, events and change set drained per call as execute_erc20 does
+void benchTokenApprove(const std::vector<Address>& spenders) {
+    std::size_t before = liveBytes();
+    ERC20 token("Bench", "BNC");
+    bench("allowances/erc20_approve/approve", spenders.size(), [&] {
+        for (const auto& spender : spenders) {
+            token.approve(spender, 1000);
+            token.clearEvents();
+            doNotOptimize(token.takeChanges());
+        }
+    });
+    report("allowances/erc20_approve/memory",
+           static_cast<double>(liveBytes() - before) / static_cast<double>(spenders.size()), "bytes/approval");
+}
+
+// Spam-like traffic that must not grow token state: balance/allowance
+// probes on unknown addresses, zero-value transfers and approvals, and
+// transfers rejected for insufficient balance or allowance
+void benchStateSpam(const std::vector<Address>& holders, const std::vector<Address>& strangers) {
+    ERC20 token("Bench", "BNC");
+    Address sender{};
+    sender.fill(0xAA);
+    token.mint(sender, 1000000);
+    for (const auto& holder : holders) token.mint(holder, 1);
+
+    const std::size_t holdersBefore = token.holderCount();
+    const std::size_t allowancesBefore = token.allowanceCount();
+    const std::size_t bytesBefore = liveBytes();
+
+    bench("spam/probe_balance_allowance", strangers.size(), [&] {
+        for (const auto& stranger : strangers) {
+            doNotOptimize(token.balanceOf(stranger));
+            doNotOptimize(token.allowance(stranger, sender));
+        }
+    });
+    bench("spam/zero_value_transfer_approve", strangers.size(), [&] {
+        for (const auto& stranger : strangers) {
+            token.transfer(stranger, 0);
+            token.approve(stranger, 0);
+        }
+    });
+    bench("spam/rejected_transfer_transfer_from", strangers.size(), [&] {
+        for (const auto& stranger : strangers) {
+            token.transfer(stranger, 2000000);
+            token.transferFrom(stranger, sender, 1);
+        }
+    });
+
+    report("spam/state_growth/entries",
+           static_cast<double>(static_cast<std::ptrdiff_t>(token.holderCount() + token.allowanceCount() -
+                                                           holdersBefore - allowancesBefore)),
+           "entries");
+    report("spam/state_growth/bytes", static_cast<double>(static_cast<std::ptrdiff_t>(liveBytes() - bytesBefore)),
+           "bytes");
+    if (token.holderCount() != holdersBefore || token.allowanceCount() != allowancesBefore) {
+        std::fprintf(stderr, "spam workload grew token state\n");
+        std::abort();
+    }
+}
+
+// Random values spread over 64..256 significant bits
+std::vector<Uint256> randomUint256s(std::size_t count, uint64_t seed) {
+    std::mt19937_64 rng(seed);
+    std::vector<Uint256> values(count);
+    for (auto& value : values) {
+        std::size_t limbs = 1 + rng() % 4;
+        uint64_t l[4] = {0, 0, 0, 0};
+        for (std::size_t i = 0; i < limbs; ++i) l[i] = rng();
+        value = Uint256::fromLimbs(l[0], l[1], l[2], l[3]);
+    }
+    return values;
+}
+
+boost::multiprecision::uint256_t toBoost(const Uint256& value) {
+    boost::multiprecision::uint256_t result = 0;
+    for (std::size_t i = Uint256::kLimbs; i-- > 0;) {
+        result <<= 64;
+        result += value.limb(i);
+    }
+    return result;
+}
+
+bool checkedAdd(const Uint256& a, const Uint256& b, Uint256& out) {
+    return addOverflow(a, b, out);
+}
+
+bool checkedAdd(const boost::multiprecision::uint256_t& a, const boost::multiprecision::uint256_t& b,
+                boost::multiprecision::uint256_t& out) {
+    out = a + b;
+    return out < a;
+}
+
+template <typename T>
+void benchUint256(const char* label, const std::vector<T>& lhs, const std::vector<T>& rhs) {
+    const std::size_t n = lhs.size();
+    std::string prefix = std::string("uint256/") + label;
+
+    bench((prefix + "/add").c_str(), n, [&] {
+        T acc = 0;
+        for (std::size_t i = 0; i < n; ++i) acc += lhs[i];
+        doNotOptimize(acc);
+    });
+    bench((prefix + "/sub").c_str(), n, [&] {
+        T acc = 0;
+        for (std::size_t i = 0; i < n; ++i) acc -= rhs[i];
+        doNotOptimize(acc);
+    });
+    bench((prefix + "/compare").c_str(), n, [&] {
+        std::size_t less = 0;
+        for (std::size_t i = 0; i < n; ++i) less += (lhs[i] <= rhs[i]);
+        doNotOptimize(less);
+    });
+    bench((prefix + "/checked_add").c_str(), n, [&] {
+        std::size_t overflows = 0;
+        T out = 0;
+        for (std::size_t i = 0; i < n; ++i) overflows += checkedAdd(lhs[i], rhs[i], out);
+        doNotOptimize(overflows);
+        doNotOptimize(out);
+    });
+    bench((prefix + "/mul").c_str(), n, [&] {
+        T acc = 1;
+        for (std::size_t i = 0; i < n; ++i) acc = lhs[i] * rhs[i] + acc;
+        doNotOptimize(acc);
+    });
+
+    std::vector<std::string> decimals(n);
+    bench((prefix + "/to_decimal").c_str(), n, [&] {
+        for (std::size_t i = 0; i < n; ++i) decimals[i] = lhs[i].str();
+    });
+    bench((prefix + "/from_decimal").c_str(), n, [&] {
+        for (std::size_t i = 0; i < n; ++i) doNotOptimize(T(decimals[i]));
+    });
+}
+
+// Model-checked random ledger operations with amounts clustered around 0 and
+// 2^256, so every overflow/underflow guard is hit. Aborts on any mismatch.
+void fuzzLedger(std::size_t iterations) {
+    using Wide = boost::multiprecision::uint512_t;
+    const Wide kMax = toBoost(Uint256::max());
+
+    std::vector<Address> pool(6);
+    for (std::size_t i = 0; i < pool.size(); ++i) pool[i].fill(static_cast<uint8_t>(0x10 * i));
+    Address sender{};
+    sender.fill(0xAA);
+    pool[1] = sender;  // pool[0] stays the zero address
+
+    ERC20 token("Fuzz", "FZZ");
+    std::map<Address, Wide> balances;
+    std::map<Address, Wide> allowances;  // granted by each owner to `sender`
+    Wide supply = 0;
+    std::mt19937_64 rng(99);
+
+    auto pickValue = [&](const Address& holder) -> Wide {
+        const Wide room = kMax - supply;
+        const Wide candidates[] = {0, 1, 2, kMax, kMax - 1, kMax / 2, kMax / 2 + 1, room, room + 1,
+                                   balances[holder], balances[holder] + 1, Wide(rng() % 1000)};
+        Wide value = candidates[rng() % std::size(candidates)];
+        return value > kMax ? kMax : value;
+    };
+    auto toToken = [](const Wide& value) { return Uint256(value.str()); };
+    auto move = [&](const Address& from, const Address& to, const Wide& value) {
+        balances[from] -= value;
+        balances[to] += value;
+    };
+
+    bench("fuzz/ledger_boundaries", iterations, [&] {
+        for (std::size_t n = 0; n < iterations; ++n) {
+            const Address& a = pool[rng() % pool.size()];
+            const Address& b = pool[rng() % pool.size()];
+            Wide value = pickValue(a);
+            Erc20Status expected = Erc20Status::Ok;
+            Erc20Status actual;
+
+            switch (rng() % 5) {
+                case 0:
+                    if (a == Address{}) expected = Erc20Status::InvalidReceiver;
+                    else if (supply + value > kMax) expected = Erc20Status::SupplyOverflow;
+                    else { balances[a] += value; supply += value; }
+                    actual = token.mint(a, toToken(value));
+                    break;
+                case 1:
+                    if (a == Address{}) expected = Erc20Status::InvalidSender;
+                    else if (balances[a] < value) expected = Erc20Status::InsufficientBalance;
+                    else { balances[a] -= value; supply -= value; }
+                    actual = token.burn(a, toToken(value));
+                    break;
+                case 2:
+                    value = pickValue(sender);
+                    if (b == Address{}) expected = Erc20Status::InvalidReceiver;
+                    else if (balances[sender] < value) expected = Erc20Status::InsufficientBalance;
+                    else move(sender, b, value);
+                    token.transfer(b, toToken(value));
+                    actual = token.lastStatus();
+                    break;
+                case 3:
+                    allowances[a] = (a == sender) ? value : allowances[a];
+                    token.approve(a, toToken(value));
+                    actual = token.lastStatus();
+                    break;
+                default:
+                    if (value > balances[a]) expected = Erc20Status::InsufficientBalance;
+                    else if (value > allowances[a]) expected = Erc20Status::InsufficientAllowance;
+                    else if (a == Address{}) expected = Erc20Status::InvalidSender;
+                    else if (b == Address{}) expected = Erc20Status::InvalidReceiver;
+                    else { move(a, b, value); allowances[a] -= value; }
+                    token.transferFrom(a, b, toToken(value));
+                    actual = token.lastStatus();
+                    break;
+            }
+
+            bool ok = (actual == expected) && toBoost(token.totalSupply()) == supply;
+            std::size_t holders = 0;
+            for (const auto& address : pool) {
+                ok &= toBoost(token.balanceOf(address)) == balances[address];
+                ok &= toBoost(token.allowance(address, sender)) == allowances[address];
+                holders += (balances[address] != 0);
+            }
+            ok &= (token.holderCount() == holders);
+            if (!ok) {
+                std::fprintf(stderr, "ledger fuzz mismatch at step %zu: %s\n", n, erc20StatusMessage(actual));
+                std::abort();
+            }
+        }
+    });
+}
+
+// The stringstream/stoi codecs the hex tables replaced, kept as the baseline
+std::string legacyAddressToString(const Address& address) {
+    std::stringstream ss;
+    ss << "0x";
+    for (const auto& byte : address) {
+        ss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(byte);
+    }
+    return ss.str();
+}
+
+Address legacyStringToAddress(const std::string& text) {
+    auto hex_value = text.substr(2);
+    Address result{};
+    for (std::size_t i = 0; i < result.size(); ++i) {
+        result[i] = static_cast<uint8_t>(std::stoi(hex_value.substr(i * 2, 2), nullptr, 16));
+    }
+    return result;
+}
+
+std::string legacyUint256ToHex(const uint256_t& value) {
+    std::stringstream ss;
+    ss << std::hex << value;
+    return ss.str();
+}
+
+void benchHexCodec(const std::vector<Address>& addresses, const std::vector<Uint256>& values) {
+    const std::size_t n = addresses.size();
+    std::vector<std::string> texts(n);
+
+    bench("hex/address_format/stringstream", n, [&] {
+        for (std::size_t i = 0; i < n; ++i) texts[i] = legacyAddressToString(addresses[i]);
+    });
+    bench("hex/address_format/string", n, [&] {
+        for (std::size_t i = 0; i < n; ++i) texts[i] = addressToString(addresses[i]);
+    });
+    bench("hex/address_format/buffer", n, [&] {
+        char buffer[ADDRESS_HEX_LENGTH];
+        for (std::size_t i = 0; i < n; ++i) {
+            addressToHex(addresses[i], buffer);
+            doNotOptimize(buffer);
+        }
+    });
+
+    bench("hex/address_parse/stoi", n, [&] {
+        for (std::size_t i = 0; i < n; ++i) doNotOptimize(legacyStringToAddress(texts[i]));
+    });
+    bench("hex/address_parse/table", n, [&] {
+        for (std::size_t i = 0; i < n; ++i) doNotOptimize(convertStringToAddress(texts[i]));
+    });
+
+    bench("hex/uint256_format/stringstream", n, [&] {
+        for (std::size_t i = 0; i < n; ++i) texts[i] = legacyUint256ToHex(values[i]);
+    });
+    bench("hex/uint256_format/buffer", n, [&] {
+        char buffer[UINT256_HEX_DIGITS];
+        for (std::size_t i = 0; i < n; ++i) doNotOptimize(uint256ToHex(values[i], buffer));
+    });
+    bench("hex/uint256_parse/constructor", n, [&] {
+        for (std::size_t i = 0; i < n; ++i) doNotOptimize(Uint256("0x" + texts[i]));
+    });
+    bench("hex/uint256_parse/table", n, [&] {
+        Uint256 value;
+        for (std::size_t i = 0; i < n; ++i) {
+            hexToUint256(texts[i].data(), texts[i].size(), value);
+            doNotOptimize(value);
+        }
+    });
+
+    // The table codecs must round-trip what the legacy ones produced
+    for (std::size_t i = 0; i < n; ++i) {
+        Uint256 value;
+        if (addressToString(addresses[i]) != legacyAddressToString(addresses[i]) ||
+            uint256_to_hex(values[i]) != legacyUint256ToHex(values[i]) ||
+            !hexToUint256(texts[i].data(), texts[i].size(), value) || value != values[i]) {
+            std::fprintf(stderr, "hex codec mismatch at %zu\n", i);
+            std::abort();
+        }
+    }
+}
+
+// Bulk validation of a batch where every other address is malformed
+void benchAddressValidation(const std::vector<Address>& addresses) {
+    const std::size_t n = addresses.size();
+    std::vector<std::string> texts(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        texts[i] = addressToString(addresses[i]);
+        if (i % 4 == 1) texts[i][17] = 'g';
+        if (i % 4 == 3) texts[i].pop_back();
+    }
+
+    bench("address_validate/parse_address", n, [&] {
+        std::size_t valid = 0;
+        Address address;
+        for (const auto& text : texts) valid += (parseAddress(text, address) == AddressParseError::Ok);
+        doNotOptimize(valid);
+    });
+    bench("address_validate/convert_with_exceptions", n, [&] {
+        std::size_t valid = 0;
+        for (const auto& text : texts) {
+            try {
+                doNotOptimize(convertStringToAddress(text));
+                ++valid;
+            } catch (const std::invalid_argument&) {
+            }
+        }
+        doNotOptimize(valid);
+    });
+}
+
+std::string readFile(const char* path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// A transferFrom call whose application input carries `recipients` addresses
+std::string generatedInput(const std::vector<Address>& recipients) {
+    std::string text = R"({"version":1,"accountInfo":{"accountAddress":"0x0202020202020202020202020202020202020202",)"
+                       R"("accountBalance":"0xffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffffff"},)"
+                       R"("protocolInput":{"version":1,"blockHeight":31415972,"blockTime":1694152781},)"
+                       R"("applicationInput":{"contractFn":"airdrop","amount":100,"recipients":[)";
+    for (std::size_t i = 0; i < recipients.size(); ++i) {
+        if (i) text += ',';
+        text += '"' + addressToString(recipients[i]) + '"';
+    }
+    text += R"(]},"contractInput":{"contractFn":"transferFrom","functionInputs":{"erc20":{"transferFrom":{)"
+            R"("from":"0x0303030303030303030303030303030303030303","to":"0x0404040404040404040404040404040404040404",)"
+            R"("value":"0xffff"}}}}})";
+    return text;
+}
+
+void benchInputDecode(const char* label, const std::string& text, std::size_t iterations) {
+    std::string prefix = std::string("gather/") + label;
+    bench((prefix + "/dom").c_str(), iterations, [&] {
+        for (std::size_t i = 0; i < iterations; ++i) {
+            ComputeInputs inputs;
+            inputs.from_json(json::parse(text));
+            doNotOptimize(inputs.version);
+        }
+    });
+    bench((prefix + "/sax").c_str(), iterations, [&] {
+        for (std::size_t i = 0; i < iterations; ++i) {
+            ComputeInputs inputs = ComputeInputs::parse(text);
+            doNotOptimize(inputs.version);
+        }
+    });
+}
+
+// Round-trips the inputs through the binary format, then times both decoders
+void benchWireFormat(const char* label, const std::string& text, std::size_t iterations) {
+    ComputeInputs original = ComputeInputs::parse(text);
+    std::string binary = original.to_binary();
+    json expected, actual;
+    original.to_json(expected);
+    ComputeInputs::from_binary(binary).to_json(actual);
+    if (expected != actual) {
+        std::fprintf(stderr, "wire round trip mismatch for %s\n", label);
+        std::abort();
+    }
+    std::string prefix = std::string("wire/") + label;
+    report(prefix + "/json_bytes", static_cast<double>(text.size()), "bytes");
+    report(prefix + "/binary_bytes", static_cast<double>(binary.size()), "bytes");
+    bench((prefix + "/json_decode").c_str(), iterations, [&] {
+        for (std::size_t i = 0; i < iterations; ++i) {
+            ComputeInputs inputs = ComputeInputs::parse(text);
+            doNotOptimize(inputs.version);
+        }
+    });
+    bench((prefix + "/binary_decode").c_str(), iterations, [&] {
+        for (std::size_t i = 0; i < iterations; ++i) {
+            ComputeInputs inputs = ComputeInputs::from_binary(binary);
+            doNotOptimize(inputs.version);
+        }
+    });
+    bench((prefix + "/binary_encode").c_str(), iterations, [&] {
+        for (std::size_t i = 0; i < iterations; ++i) {
+            std::string out = original.to_binary();
+            doNotOptimize(out.data());
+        }
+    });
+}
+
+// One result of each type with a representative value
+Erc20Result sampleResult(Erc20Result::Erc20ResultType type) {
+    using Type = Erc20Result::Erc20ResultType;
+    Erc20Result result;
+    switch (type) {
+        case Type::EnumName: result.setText(type, "Quote\"d \\ token"); break;
+        case Type::EnumSymbol: result.setText(type, std::string(ERC20_RESULT_TEXT_CAPACITY, 'S')); break;
+        case Type::EnumDecimals: result.setDecimals(18); break;
+        case Type::EnumTotalSupply: result.setAmount(type, Uint256::max()); break;
+        case Type::EnumBalanceOf: result.setAmount(type, uint256_t(12345)); break;
+        case Type::EnumAllowance: result.setAmount(type, uint256_t(678)); break;
+        case Type::EnumTransfer:
+        case Type::EnumTransferFrom:
+        case Type::EnumApprove:
+        case Type::EnumTransferBatch: result.setSuccess(type, type != Type::EnumTransferFrom); break;
+        default: result.setType(type); break;
+    }
+    return result;
+}
+
+constexpr Erc20Result::Erc20ResultType kAllResultTypes[] = {
+    Erc20Result::Erc20ResultType::EnumName,        Erc20Result::Erc20ResultType::EnumSymbol,
+    Erc20Result::Erc20ResultType::EnumDecimals,    Erc20Result::Erc20ResultType::EnumTotalSupply,
+    Erc20Result::Erc20ResultType::EnumBalanceOf,   Erc20Result::Erc20ResultType::EnumTransfer,
+    Erc20Result::Erc20ResultType::EnumTransferFrom, Erc20Result::Erc20ResultType::EnumApprove,
+    Erc20Result::Erc20ResultType::EnumAllowance,   Erc20Result::Erc20ResultType::EnumTransferBatch,
+    Erc20Result::Erc20ResultType::EnumUnknown};
+
+// Every result type must survive a byte copy and decode back to the same JSON it encodes to
+void checkOutputWireRoundTrip() {
+    for (auto type : kAllResultTypes) {
+        ContractOutputs output;
+        const Erc20Result result = sampleResult(type);
+        Erc20Result copy;
+        std::memcpy(static_cast<void*>(&copy), &result, sizeof(Erc20Result));
+        output.result.setResult(copy);
+        ContractOutputs decoded;
+        decoded.from_binary(output.to_binary());
+        std::string compact;
+        output.appendCompactJson(compact);
+        if (decoded.to_json() != output.to_json() || compact != output.to_json().dump() ||
+            std::get<Erc20Result>(decoded.result.result).getType() != type) {
+            std::fprintf(stderr, "output wire round trip mismatch for type %d\n", static_cast<int>(type));
+            std::abort();
+        }
+    }
+
+    bool rejected = false;
+    try {
+        Erc20Result result;
+        result.setText(Erc20Result::Erc20ResultType::EnumName, std::string(ERC20_RESULT_TEXT_CAPACITY + 1, 'N'));
+    } catch (const std::length_error&) {
+        rejected = true;
+    }
+    if (!rejected) {
+        std::fprintf(stderr, "oversized result text was accepted\n");
+        std::abort();
+    }
+}
+
+// Building, copying and serializing results; none of these may allocate except the output string
+void benchResults(std::size_t iterations) {
+    using Type = Erc20Result::Erc20ResultType;
+    // Counted inside the timed loops only; reporting a result may allocate
+    std::size_t allocations = 0;
+    auto counted = [&](auto&& loop) {
+        const std::size_t before = allocationCount();
+        loop();
+        allocations += allocationCount() - before;
+    };
+    bench("results/construct_text", iterations, [&] {
+        counted([&] {
+            for (std::size_t i = 0; i < iterations; ++i) {
+                Erc20Result result;
+                result.setText(Type::EnumSymbol, "MTK");
+                doNotOptimize(&result);
+            }
+        });
+    });
+    bench("results/construct_amount", iterations, [&] {
+        counted([&] {
+            for (std::size_t i = 0; i < iterations; ++i) {
+                Erc20Result result;
+                result.setAmount(Type::EnumBalanceOf, uint256_t(i));
+                doNotOptimize(&result);
+            }
+        });
+    });
+    ContractResult slot;
+    const Erc20Result name = sampleResult(Type::EnumName);
+    bench("results/copy_into_variant", iterations, [&] {
+        counted([&] {
+            for (std::size_t i = 0; i < iterations; ++i) {
+                slot.setResult(name);
+                doNotOptimize(&slot);
+            }
+        });
+    });
+    if (allocations != 0) {
+        std::fprintf(stderr, "building a result allocated\n");
+        std::abort();
+    }
+
+    const std::pair<const char*, Type> serialized[] = {{"results/serialize_compact_name", Type::EnumName},
+                                                       {"results/serialize_compact_balance", Type::EnumBalanceOf},
+                                                       {"results/serialize_compact_transfer", Type::EnumTransfer}};
+    for (const auto& [label, type] : serialized) {
+        ContractOutputs output;
+        output.result.setResult(sampleResult(type));
+        std::string out;
+        out.reserve(256);
+        bench(label, iterations, [&] {
+            for (std::size_t i = 0; i < iterations; ++i) {
+                out.clear();
+                output.appendCompactJson(out);
+                doNotOptimize(out.data());
+            }
+        });
+    }
+}
+
+// The compact writer must produce exactly what to_json().dump() does
+void benchOutputCommit(std::size_t iterations) {
+    using Type = Erc20Result::Erc20ResultType;
+    for (Type type : {Type::EnumName, Type::EnumDecimals, Type::EnumBalanceOf, Type::EnumTransfer, Type::EnumApprove,
+                      Type::EnumAllowance}) {
+        ContractOutputs output;
+        output.result.setResult(sampleResult(type));
+
+        if (type == Type::EnumTransfer) {
+            Address a{}, b{};
+            a.fill(0x11);
+            b.fill(0x22);
+            output.stateDelta.record(Erc20StateChange::Slot::Balance, a, Address{}, uint256_t(5), uint256_t(0));
+            output.stateDelta.record(Erc20StateChange::Slot::Allowance, a, b, uint256_t(0), Uint256::max());
+            output.stateDelta.record(Erc20StateChange::Slot::TotalSupply, Address{}, Address{}, uint256_t(9),
+                                     uint256_t(4));
+            output.error = "ERC20: \"quoted\" failure";
+        }
+
+        std::string compact;
+        output.appendCompactJson(compact);
+        if (compact != output.to_json().dump()) {
+            std::fprintf(stderr, "compact output mismatch for type %d: %s\n", static_cast<int>(type), compact.c_str());
+            std::abort();
+        }
+    }
+
+    ContractOutputs output;
+    std::get<Erc20Result>(output.result.result).setAmount(Type::EnumBalanceOf,
+                                                         uint256_t("123456789012345678901234567890"));
+    bench("commit/pretty_labelled", iterations, [&] {
+        for (std::size_t i = 0; i < iterations; ++i) {
+            std::string out = std::string("contractOutput :") + output.to_json().dump(CUSTOM_INDENT_SPACES) + "\n";
+            doNotOptimize(out.data());
+        }
+    });
+    bench("commit/compact_record", iterations, [&] {
+        std::string out;
+        out.reserve(256);
+        for (std::size_t i = 0; i < iterations; ++i) {
+            out.clear();
+            output.appendCompactJson(out);
+            out += '\n';
+            doNotOptimize(out.data());
+        }
+    });
+}
+
+// `calls` transfers of 1 from the contract sender to random recipients
+std::vector<ComputeInputs> transferCalls(std::size_t calls) {
+    ComputeInputs call = ComputeInputs::parse(readFile("sample-contract-input2.json"));
+    call.has_application_input = false;
+    call.contract_input.contract_fn = "transfer";
+    std::vector<ComputeInputs> inputs;
+    for (const auto& recipient : randomAddresses(calls, 6)) {
+        call.contract_input.function_inputs.erc20.transfer.address = recipient;
+        call.contract_input.function_inputs.erc20.transfer.value = uint256_t(1);
+        inputs.push_back(call);
+    }
+    return inputs;
+}
+
+ERC20 fundedToken() {
+    ERC20 token("MyToken", "MTK");
+    Address sender{};
+    sender.fill(0xAA);
+    token.mint(sender, Uint256::fromLimbs(0, 0, 1, 0));
+    token.takeChanges();
+    return token;
+}
+
+// Calls per second through process_erc20_batch, with results sent to /dev/null
+void benchBatchStream(const char* label, const std::string& stream, std::size_t calls) {
+    int devNull = ::open("/dev/null", O_WRONLY);
+    ERC20 token = fundedToken();
+    std::istringstream in(stream);
+    std::size_t processed = 0;
+    auto start = std::chrono::steady_clock::now();
+    processed = process_erc20_batch(token, in, devNull);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    ::close(devNull);
+    if (processed != calls || token.holderCount() != calls + 1) {
+        std::fprintf(stderr, "batch/%s processed %zu of %zu calls\n", label, processed, calls);
+        std::abort();
+    }
+    report(std::string("batch/") + label, static_cast<double>(calls) / seconds, "calls/sec", calls);
+}
+
+#ifndef __EMSCRIPTEN__
+// Calls per second when every call starts a fresh `bench --contract` process
+void benchProcessPerCall(const std::string& record, std::size_t calls) {
+    char path[] = "/tmp/versatus-bench-XXXXXX";
+    int fd = ::mkstemp(path);
+    writeOutput(record.data(), record.size(), fd);
+    ::close(fd);
+
+    char self[] = "/proc/self/exe";
+    char flag[] = "--contract";
+    char* args[] = {self, flag, nullptr};
+    auto start = std::chrono::steady_clock::now();
+    for (std::size_t i = 0; i < calls; ++i) {
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, path, O_RDONLY, 0);
+        posix_spawn_file_actions_addopen(&actions, STDOUT_FILENO, "/dev/null", O_WRONLY, 0);
+        pid_t pid;
+        if (posix_spawn(&pid, self, &actions, nullptr, args, nullptr) != 0) {
+            std::fprintf(stderr, "posix_spawn failed\n");
+            std::abort();
+        }
+        int status = 0;
+        ::waitpid(pid, &status, 0);
+        posix_spawn_file_actions_destroy(&actions);
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    ::unlink(path);
+    report("batch/process_per_call", static_cast<double>(calls) / seconds, "calls/sec", calls);
+}
+#endif
+
+// Every balance, allowance and count of `token` must match the snapshot-free `model`
+void checkSameLedger(const char* label, const ERC20& token, const ERC20& model, const std::vector<Address>& accounts,
+                     const Address& sender) {
+    bool same = token.totalSupply() == model.totalSupply() && token.holderCount() == model.holderCount() &&
+                token.allowanceCount() == model.allowanceCount() && token.balanceOf(sender) == model.balanceOf(sender);
+    for (const auto& account : accounts) {
+        same = same && token.balanceOf(account) == model.balanceOf(account) &&
+               token.allowance(sender, account) == model.allowance(sender, account);
+    }
+    if (!same) {
+        std::fprintf(stderr, "snapshot/%s: ledger differs from the in-memory model\n", label);
+        std::abort();
+    }
+}
+
+// forEachAllowance() must visit exactly the model's nonzero allowances of
+// every owner: in memory, over a mapped snapshot, and after patching it
+void checkForEachAllowance(std::size_t iterations) {
+    const std::string path = "/tmp/versatus-bench-allowances";
+    Address sender{};
+    sender.fill(0xAA);
+    std::vector<Address> owners(4), spenders(8);
+    for (std::size_t i = 0; i < owners.size(); ++i) owners[i].fill(static_cast<uint8_t>(0x10 + i));
+    for (std::size_t i = 0; i < spenders.size(); ++i) spenders[i].fill(static_cast<uint8_t>(0x40 + i));
+    owners[0] = sender;
+    spenders[0] = Address{};
+    spenders[1] = sender;
+
+    ERC20 token("Enum", "ENM");
+    std::map<std::pair<Address, Address>, uint256_t> model;
+    std::mt19937_64 rng(23);
+    Erc20ChangeSet change;
+
+    auto verify = [&](const char* label, const ERC20& ledger) {
+        for (const auto& owner : owners) {
+            std::vector<std::pair<Address, uint256_t>> visited, expected;
+            ledger.forEachAllowance(owner, [&](const Address& spender, const uint256_t& value) {
+                visited.emplace_back(spender, value);
+            });
+            std::sort(visited.begin(), visited.end());
+            for (const auto& [key, value] : model) {
+                if (key.first == owner && value != 0) expected.emplace_back(key.second, value);
+            }
+            if (visited != expected) {
+                std::fprintf(stderr, "allowances/%s: forEachAllowance differs from the model\n", label);
+                std::abort();
+            }
+        }
+    };
+    auto run = [&](const char* label, std::size_t count) {
+        for (std::size_t n = 0; n < count; ++n) {
+            const Address& owner = owners[rng() % owners.size()];
+            const Address& spender = spenders[rng() % spenders.size()];
+            const uint256_t value = (rng() % 3 == 0) ? uint256_t(0) : uint256_t(rng() % 1000 + 1);
+            if (owner == sender && rng() % 2 == 0) {
+                token.approve(spender, value);
+            } else {
+                change.clear();
+                change.record(Erc20StateChange::Slot::Allowance, owner, spender, token.allowance(owner, spender),
+                              value);
+                token.applyChanges(change);
+            }
+            model[{owner, spender}] = value;
+            if (n % 8 == 0) verify(label, token);
+        }
+        verify(label, token);
+    };
+
+    run("memory", iterations);
+    token.saveSnapshot(path);
+    verify("saved", token);
+    run("snapshot_overlay", iterations);
+    token.saveSnapshot(path);
+    verify("resaved", token);
+    verify("reopened", ERC20(Erc20Snapshot::open(path)));
+    ::unlink(path.c_str());
+}
+
+void benchSnapshot(const std::vector<Address>& holders) {
+    const std::string path = "/tmp/versatus-bench-snapshot";
+    Address sender{};
+    sender.fill(0xAA);
+
+    ERC20 model("MyToken", "MTK");
+    model.mint(sender, Uint256::fromLimbs(0, 0, 1, 0));
+    for (std::size_t i = 0; i < holders.size(); ++i) model.mint(holders[i], uint256_t(i + 1));
+    for (std::size_t i = 0; i < holders.size(); i += 100) model.approve(holders[i], uint256_t(i + 7));
+
+    bench("snapshot/full_write", holders.size(), [&] { model.saveSnapshot(path); });
+
+    auto start = std::chrono::steady_clock::now();
+    ERC20 token(Erc20Snapshot::open(path));
+    double openUs = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count();
+    report("snapshot/open", openUs, "us");
+    checkSameLedger("open", token, model, holders, sender);
+
+    bench("snapshot/balance_of_mapped", holders.size(), [&] {
+        for (const auto& holder : holders) doNotOptimize(token.balanceOf(holder));
+    });
+
+    // Spend some balances to zero and move others: every key exists, so the save patches in place
+    for (std::size_t i = 0; i < std::min<std::size_t>(holders.size(), 1000); ++i) {
+        for (ERC20* ledger : {&token, &model}) {
+            if (i % 3 == 0) ledger->burn(holders[i], uint256_t(i + 1));
+            else ledger->transfer(holders[i], uint256_t(5));
+            if (i % 100 == 0) ledger->approve(holders[i], uint256_t(0));
+        }
+    }
+    checkSameLedger("overlay", token, model, holders, sender);
+    bench("snapshot/incremental_save_1000_changes", 1000, [&] { token.saveSnapshot(path); });
+    checkSameLedger("incremental_save", token, model, holders, sender);
+    checkSameLedger("incremental_reopen", ERC20(Erc20Snapshot::open(path)), model, holders, sender);
+
+    // A new holder forces a compacting rewrite that drops the zeroed records
+    Address newcomer{};
+    newcomer.fill(0x5A);
+    for (ERC20* ledger : {&token, &model}) ledger->transfer(newcomer, uint256_t(11));
+    bench("snapshot/compacting_rewrite", holders.size(), [&] { token.saveSnapshot(path); });
+    checkSameLedger("rewrite", ERC20(Erc20Snapshot::open(path)), model, holders, sender);
+    if (token.balanceOf(newcomer) != uint256_t(11)) std::abort();
+
+    // 2^61 more balance records wrap the unchecked size back to the real one
+    int fd = ::open(path.c_str(), O_RDWR);
+    SnapshotHeader header{};
+    if (fd < 0 || ::pread(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))) std::abort();
+    header.balanceCount += uint64_t(1) << 61;
+    if (::pwrite(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header))) std::abort();
+    ::close(fd);
+    bool rejected = false;
+    try {
+        Erc20Snapshot::open(path);
+    } catch (const std::runtime_error&) {
+        rejected = true;
+    }
+    if (!rejected) {
+        std::fprintf(stderr, "snapshot/overflowing_counts: corrupt header was accepted\n");
+        std::abort();
+    }
+    ::unlink(path.c_str());
+}
+
+// Journals every committed call, rolls back the calls in between, and checks
+// that replaying the journal on a copy of the starting state lands on the same ledger
+void benchJournal(const std::vector<Address>& holders, std::size_t calls) {
+    const std::string path = "/tmp/versatus-bench-journal";
+    ::unlink(path.c_str());
+    Address sender{};
+    sender.fill(0xAA);
+
+    ERC20 live = fundedToken();
+    ERC20 model = fundedToken();
+    std::mt19937_64 rng(7);
+    auto randomCall = [&](ERC20& token, uint64_t roll) {
+        const Address& target = holders[roll % holders.size()];
+        switch (roll % 4) {
+            case 0: token.transfer(target, uint256_t(roll % 1000)); break;
+            case 1: token.approve(target, uint256_t(roll % 77)); break;
+            case 2: token.burn(target, uint256_t(roll % 3)); break;
+            default: token.mint(target, uint256_t(roll % 500)); break;
+        }
+    };
+
+    {
+        // Synced once at the end, so the bench measures encoding and append rather than the disk
+        Erc20Journal journal(path, JournalSync::Manual);
+        bench("journal/call_take_append", calls, [&] {
+            for (std::size_t i = 0; i < calls; ++i) {
+                uint64_t roll = rng();
+                randomCall(live, roll);
+                randomCall(model, roll);
+                journal.append(live.takeChanges().coalesced());
+            }
+        });
+        journal.sync();
+        bench("journal/call_rollback", calls, [&] {
+            for (std::size_t i = 0; i < calls; ++i) {
+                randomCall(live, rng());
+                live.rollback();
+            }
+        });
+    }
+    checkSameLedger("rollback", live, model, holders, sender);
+
+    ERC20 replica = fundedToken();
+    std::size_t records = 0;
+    bench("journal/replay", calls, [&] {
+        records = Erc20Journal::replay(path, [&](const Erc20ChangeSet& changes) { replica.applyChanges(changes); });
+    });
+    checkSameLedger("replay", replica, live, holders, sender);
+    if (!replica.changes().empty() || records == 0) std::abort();
+
+    // A crash mid-append leaves a length prefix promising more than was
+    // written; reopening must cut it off so the next record stays readable
+    {
+        std::ofstream torn(path, std::ios::binary | std::ios::app);
+        const char tail[] = {100, 0, 0, 0, 1, 2, 3};
+        torn.write(tail, sizeof(tail));
+    }
+    {
+        Erc20Journal journal(path);
+        randomCall(live, rng());
+        journal.append(live.takeChanges().coalesced());
+    }
+    ERC20 recovered = fundedToken();
+    const std::size_t recoveredRecords = Erc20Journal::replay(
+        path, [&](const Erc20ChangeSet& changes) { recovered.applyChanges(changes); });
+    checkSameLedger("torn_tail_reopen", recovered, live, holders, sender);
+    if (recoveredRecords != records + 1) std::abort();
+
+    // A crash before the header was complete leaves a file to start over
+    {
+        std::ofstream torn(path, std::ios::binary | std::ios::trunc);
+        torn.write(WIRE_JOURNAL_MAGIC, 3);
+    }
+    {
+        Erc20Journal journal(path);
+        ERC20 token = fundedToken();
+        token.mint(sender, uint256_t(5));
+        journal.append(token.takeChanges());
+    }
+    if (Erc20Journal::replay(path, [](const Erc20ChangeSet&) {}) != 1) std::abort();
+    ::unlink(path.c_str());
+}
+
+// A rejected call reports its status and leaves no writes behind
+void checkFailedCallRollback() {
+    ERC20 token = fundedToken();
+    const uint256_t supply = token.totalSupply();
+    Address from{}, to{};
+    from.fill(0x11);
+    to.fill(0x22);
+
+    ContractInputs call;
+    call.contract_fn = "transferFrom";
+    call.function_inputs.erc20.transfer_from.from = from;
+    call.function_inputs.erc20.transfer_from.to = to;
+    call.function_inputs.erc20.transfer_from.value = uint256_t(1);
+    ContractOutputs output;
+    execute_erc20(token, call, output);
+    bool ok = output.error == erc20StatusMessage(Erc20Status::InsufficientBalance) && output.stateDelta.empty();
+
+    // Writes after a checkpoint are undone, earlier ones stay pending
+    token.mint(from, uint256_t(9));
+    const ERC20::Checkpoint checkpoint = token.checkpoint();
+    token.mint(to, uint256_t(5));
+    token.approve(to, uint256_t(3));
+    token.burn(from, uint256_t(9));
+    token.rollbackTo(checkpoint);
+    ok = ok && token.balanceOf(from) == uint256_t(9) && token.balanceOf(to) == 0 && token.holderCount() == 2 &&
+         token.allowanceCount() == 0 && token.totalSupply() == supply + uint256_t(9) && token.changes().size() == 2;
+    if (!ok) {
+        std::fprintf(stderr, "failed calls are not rolled back\n");
+        std::abort();
+    }
+}
+
+// The if-chain dispatch used before the table, extended to the same ten names
+Erc20ContractFunction legacyErc20ContractFunction(const std::string& function_name) {
+    if (function_name == "name") return ERC20_NAME;
+    if (function_name == "symbol") return ERC20_SYMBOL;
+    if (function_name == "decimals") return ERC20_DECIMALS;
+    if (function_name == "totalSupply") return ERC20_TOTALSUPPLY;
+    if (function_name == "balanceOf") return ERC20_BALANCEOF;
+    if (function_name == "allowance") return ERC20_ALLOWANCE;
+    if (function_name == "approve") return ERC20_APPROVE;
+    if (function_name == "transfer") return ERC20_TRANSFER;
+    if (function_name == "transferFrom") return ERC20_TRANSFERFROM;
+    if (function_name == "transferBatch") return ERC20_TRANSFERBATCH;
+    return UNSUPPORTED_FUNCTION;
+}
+
+// Cost of picking the handler for a call, and of a whole read-only call through dispatch_erc20
+void benchDispatch(std::size_t iterations) {
+    std::vector<std::string> names;
+    for (const auto& entry : ERC20_FUNCTIONS) names.emplace_back(entry.name);
+    names.emplace_back("mint");
+    names.emplace_back("transferOwnership");
+    for (const auto& name : names) {
+        if (getErc20ContractFunction(name) != legacyErc20ContractFunction(name)) {
+            std::fprintf(stderr, "dispatch table disagrees on %s\n", name.c_str());
+            std::abort();
+        }
+    }
+
+    const std::size_t ops = iterations * names.size();
+    bench("dispatch/if_chain", ops, [&] {
+        for (std::size_t i = 0; i < iterations; ++i) {
+            for (const auto& name : names) doNotOptimize(legacyErc20ContractFunction(name));
+        }
+    });
+    bench("dispatch/perfect_hash", ops, [&] {
+        for (std::size_t i = 0; i < iterations; ++i) {
+            for (const auto& name : names) doNotOptimize(getErc20ContractFunction(name));
+        }
+    });
+
+    ERC20 token = fundedToken();
+    ContractInputs call;
+    call.function_inputs.erc20.balance_of.account.fill(0xAA);
+    ContractOutputs output;
+    for (const char* fn : {"balanceOf", "totalSupply", "symbol"}) {
+        call.contract_fn = fn;
+        const std::string label = std::string("dispatch/call_") + fn;
+        bench(label.c_str(), iterations, [&] {
+            for (std::size_t i = 0; i < iterations; ++i) {
+                dispatch_erc20(token, call, output);
+                doNotOptimize(&output);
+            }
+        });
+    }
+    if (std::get<Erc20Result>(output.result.result).getType() != Erc20Result::Erc20ResultType::EnumSymbol ||
+        std::get<Erc20Result>(output.result.result).text() != "MTK") {
+        std::fprintf(stderr, "dispatch_erc20 returned the wrong result\n");
+        std::abort();
+    }
+}
+
+// The loops below are instantiated on ERC20, where every call resolves
+// statically, and on IERC20, where each call goes through the vtable
+template <Erc20Token Token>
+[[gnu::noinline]] uint64_t sumDecimals(const Token& token, std::size_t calls) {
+    uint64_t sum = 0;
+    for (std::size_t i = 0; i < calls; ++i) {
+        sum += token.decimals();
+        doNotOptimize(sum);
+    }
+    return sum;
+}
+
+template <Erc20Token Token>
+[[gnu::noinline]] uint256_t sumBalances(const Token& token, const std::vector<Address>& accounts) {
+    uint256_t sum;
+    for (const auto& account : accounts) sum += token.balanceOf(account);
+    return sum;
+}
+
+template <Erc20Token Token>
+[[gnu::noinline]] std::size_t airdrop(Token& token, const std::vector<Address>& recipients) {
+    std::size_t sent = 0;
+    for (const auto& recipient : recipients) sent += token.transfer(recipient, uint256_t(1));
+    return sent;
+}
+
+// Per-call overhead of the statically resolved token against the IERC20 adapter
+void benchTokenInterface(const std::vector<Address>& accounts, std::size_t rounds) {
+    ERC20 token = fundedToken();
+    IERC20Adapter<ERC20> adapter(token);
+    IERC20* dynamicToken = &adapter;
+    // Hide the dynamic type so the compiler cannot devirtualize the adapter's calls
+    asm volatile("" : "+r"(dynamicToken));
+
+    const std::size_t calls = rounds * accounts.size();
+    uint64_t staticDecimals = 0, dynamicDecimals = 0;
+    bench("token_interface/decimals_static", calls, [&] { staticDecimals = sumDecimals(token, calls); });
+    bench("token_interface/decimals_virtual", calls, [&] { dynamicDecimals = sumDecimals(*dynamicToken, calls); });
+
+    auto transferRounds = [&](auto& through) {
+        std::size_t sent = 0;
+        for (std::size_t round = 0; round < rounds; ++round) {
+            token.clearEvents();
+            sent += airdrop(through, accounts);
+            token.takeChanges();
+        }
+        return sent;
+    };
+    // Grow the recipients' balance slots and the event buffer before timing
+    std::size_t staticSent = airdrop(token, accounts), dynamicSent = 0;
+    token.clearEvents();
+    token.takeChanges();
+    bench("token_interface/transfer_static", calls, [&] { staticSent += transferRounds(token); });
+    bench("token_interface/transfer_virtual", calls, [&] { dynamicSent = transferRounds(*dynamicToken); });
+
+    uint256_t staticSum, dynamicSum;
+    bench("token_interface/balance_of_static", calls, [&] {
+        for (std::size_t round = 0; round < rounds; ++round) staticSum = sumBalances(token, accounts);
+    });
+    bench("token_interface/balance_of_virtual", calls, [&] {
+        for (std::size_t round = 0; round < rounds; ++round) dynamicSum = sumBalances(*dynamicToken, accounts);
+    });
+
+    if (staticDecimals != dynamicDecimals || staticSent != calls + accounts.size() || dynamicSent != calls ||
+        staticSum != dynamicSum || staticSum != uint256_t(static_cast<uint64_t>(staticSent + dynamicSent))) {
+        std::fprintf(stderr, "token interface results disagree\n");
+        std::abort();
+    }
+}
+
+// Random mints, burns and transfers against a plain map; afterwards both
+// ownership indexes must agree with it token by token
+void checkErc721Indexes(std::size_t iterations) {
+    Address sender{};
+    sender.fill(0xAA);
+    std::vector<Address> owners = randomAddresses(16, 11);
+    owners.push_back(sender);
+    std::mt19937_64 rng(12);
+    ERC721 collection("Collection", "COL");
+    std::map<uint64_t, Address> model;
+    bool ok = true;
+
+    for (std::size_t i = 0; i < iterations && ok; ++i) {
+        const uint64_t tokenId = rng() % 512;
+        const Address& owner = owners[rng() % owners.size()];
+        const bool exists = model.count(tokenId) != 0;
+        switch (rng() % 3) {
+            case 0:
+                ok = (collection.mint(owner, tokenId) == Erc721Status::Ok) == !exists;
+                if (!exists) model[tokenId] = owner;
+                break;
+            case 1:
+                ok = (collection.burn(tokenId) == Erc721Status::Ok) == exists;
+                model.erase(tokenId);
+                break;
+            default: {
+                // Only the sender's own tokens may move
+                const bool allowed = exists && model[tokenId] == sender;
+                const Address from = exists ? model[tokenId] : sender;
+                ok = collection.transferFrom(from, owner, tokenId) == allowed;
+                if (allowed) model[tokenId] = owner;
+                break;
+            }
+        }
+    }
+
+    std::map<Address, std::vector<uint64_t>> byOwner;
+    for (const auto& [tokenId, owner] : model) byOwner[owner].push_back(tokenId);
+    ok = ok && collection.totalSupply() == uint256_t(model.size()) && collection.holderCount() == byOwner.size();
+    for (const auto& [owner, tokens] : byOwner) {
+        const auto& indexed = collection.tokensOf(owner);
+        std::vector<uint64_t> ids;
+        for (std::size_t i = 0; i < indexed.size(); ++i) {
+            ids.push_back(toNativeUint256(indexed[i]).low64());
+            const ERC721::TokenSlot* slot = collection.findToken(indexed[i]);
+            ok = ok && slot && slot->owner == owner && slot->ownerIndex == i &&
+                 collection.tokenOfOwnerByIndex(owner, uint256_t(i)) == indexed[i];
+        }
+        std::sort(ids.begin(), ids.end());
+        ok = ok && ids == tokens && collection.balanceOf(owner) == uint256_t(tokens.size());
+    }
+    std::vector<uint64_t> all;
+    for (std::size_t i = 0; i < model.size(); ++i) {
+        const uint256_t tokenId = collection.tokenByIndex(uint256_t(i));
+        all.push_back(toNativeUint256(tokenId).low64());
+        ok = ok && collection.findToken(tokenId)->globalIndex == i;
+    }
+    std::sort(all.begin(), all.end());
+    ok = ok && std::adjacent_find(all.begin(), all.end()) == all.end() && all.size() == model.size();
+    if (!ok) {
+        std::fprintf(stderr, "ERC721 ownership indexes diverged from the model\n");
+        std::abort();
+    }
+}
+
+// Every Erc721Result type and every ERC721 input must survive the JSON and binary formats
+void checkErc721Calls() {
+    using Type = Erc721Result::Erc721ResultType;
+    Address owner{};
+    owner.fill(0x42);
+    for (uint8_t i = 0; i <= static_cast<uint8_t>(Type::EnumUnknown); ++i) {
+        const auto type = static_cast<Type>(i);
+        Erc721Result result;
+        switch (Erc721Result::kindOf(type)) {
+            case Erc721Result::ValueKind::Text: result.setText(type, "Quote\"d"); break;
+            case Erc721Result::ValueKind::Amount: result.setAmount(type, Uint256::max()); break;
+            case Erc721Result::ValueKind::Address: result.setAddress(type, owner); break;
+            case Erc721Result::ValueKind::Flag: result.setFlag(type, true); break;
+            case Erc721Result::ValueKind::None: result.setType(type); break;
+        }
+        ContractOutputs output;
+        output.result.setResult(result);
+        ContractOutputs decoded;
+        decoded.from_binary(output.to_binary());
+        std::string compact;
+        output.appendCompactJson(compact);
+        if (decoded.to_json() != output.to_json() || compact != output.to_json().dump()) {
+            std::fprintf(stderr, "ERC721 result round trip mismatch for type %d\n", static_cast<int>(i));
+            std::abort();
+        }
+    }
+
+    ComputeInputs call = ComputeInputs::parse(readFile("sample-contract-input-erc721.json"));
+    auto& erc721 = call.contract_input.function_inputs.erc721;
+    erc721.balance_of.owner = owner;
+    erc721.owner_of.token_id = uint256_t(7);
+    erc721.get_approved.token_id = uint256_t(8);
+    erc721.is_approved_for_all.owner = owner;
+    erc721.is_approved_for_all.operator_address.fill(0x43);
+    erc721.approve.to.fill(0x44);
+    erc721.approve.token_id = uint256_t(9);
+    erc721.set_approval_for_all.operator_address.fill(0x45);
+    erc721.set_approval_for_all.approved = true;
+    erc721.token_by_index.index = uint256_t(10);
+    erc721.token_of_owner_by_index.owner = owner;
+    erc721.token_of_owner_by_index.index = uint256_t(11);
+    json expected;
+    call.contract_input.to_json(expected);
+
+    json document, fromText, fromDom, fromBinary;
+    call.to_json(document);
+    ComputeInputs::parse(document.dump()).contract_input.to_json(fromText);
+    ContractInputs dom;
+    dom.from_json(expected);
+    dom.to_json(fromDom);
+    ComputeInputs::from_binary(call.to_binary()).contract_input.to_json(fromBinary);
+    if (fromText != expected || fromDom != expected || fromBinary != expected) {
+        std::fprintf(stderr, "ERC721 inputs do not round trip\n");
+        std::abort();
+    }
+}
+
+// Collection-scale costs: every index operation should stay flat as the collection grows
+void benchErc721(std::size_t tokens) {
+    Address sender{};
+    sender.fill(0xAA);
+    auto owners = randomAddresses(std::max<std::size_t>(tokens / 10, 1), 13);
+
+    const std::size_t liveBefore = liveBytes();
+    ERC721 collection("Collection", "COL");
+    collection.reserve(tokens);
+    // Events are dropped per operation, as execute_erc721 does per call, so only the indexes are measured
+    bench("erc721/mint", tokens, [&] {
+        for (uint64_t id = 0; id < tokens; ++id) {
+            collection.mint(sender, id);
+            collection.clearEvents();
+        }
+    });
+    bench("erc721/transfer_from", tokens, [&] {
+        for (uint64_t id = 0; id < tokens; ++id) {
+            collection.transferFrom(sender, owners[id % owners.size()], id);
+            collection.clearEvents();
+        }
+    });
+    report("erc721/memory", static_cast<double>(liveBytes() - liveBefore) / static_cast<double>(tokens), "bytes/token");
+
+    std::mt19937_64 rng(14);
+    std::vector<uint64_t> lookups(tokens);
+    for (auto& id : lookups) id = rng() % tokens;
+    bench("erc721/owner_of", tokens, [&] {
+        for (uint64_t id : lookups) doNotOptimize(collection.ownerOf(id));
+    });
+    bench("erc721/balance_of", owners.size(), [&] {
+        for (const auto& owner : owners) doNotOptimize(collection.balanceOf(owner));
+    });
+    bench("erc721/token_of_owner_by_index", tokens, [&] {
+        for (const auto& owner : owners) {
+            const std::size_t count = collection.tokensOf(owner).size();
+            for (std::size_t i = 0; i < count; ++i) doNotOptimize(collection.tokenOfOwnerByIndex(owner, uint256_t(i)));
+        }
+    });
+    bench("erc721/token_by_index", tokens, [&] {
+        for (std::size_t i = 0; i < tokens; ++i) doNotOptimize(collection.tokenByIndex(uint256_t(i)));
+    });
+
+    ContractInputs call;
+    call.contract_fn = "ownerOf";
+    ContractOutputs output;
+    bench("erc721/call_owner_of", tokens, [&] {
+        for (uint64_t id : lookups) {
+            call.function_inputs.erc721.owner_of.token_id = id;
+            execute_erc721(collection, call, output);
+        }
+    });
+    if (std::get<Erc721Result>(output.result.result).address() != owners[lookups.back() % owners.size()]) {
+        std::fprintf(stderr, "ERC721 ownerOf call returned the wrong owner\n");
+        std::abort();
+    }
+
+    bench("erc721/burn", tokens, [&] {
+        for (uint64_t id = 0; id < tokens; ++id) {
+            collection.burn(id);
+            collection.clearEvents();
+        }
+    });
+    if (collection.totalSupply() != 0 || collection.holderCount() != 0) {
+        std::fprintf(stderr, "ERC721 burn left tokens behind\n");
+        std::abort();
+    }
+}
+
+// One call emitting an event per recipient, as an airdrop would
+void benchEvents(const std::vector<Address>& recipients) {
+    const std::size_t count = recipients.size();
+    Address sender{};
+    sender.fill(0xAA);
+    ERC20 token = fundedToken();
+    auto airdrop = [&] {
+        token.clearEvents();
+        for (const auto& recipient : recipients) token.transfer(recipient, uint256_t(1));
+        token.takeChanges();
+    };
+    // The first call grows the arena (and the recipients' balance slots) once
+    airdrop();
+
+    token.clearEvents();
+    const std::size_t allocations = allocationCount();
+    for (const auto& recipient : recipients) token.TransferEvent(sender, recipient, uint256_t(1));
+    if (allocationCount() != allocations || token.events().size() != count) {
+        std::fprintf(stderr, "event append allocated after warm-up\n");
+        std::abort();
+    }
+
+    bench("events/append_into_arena", count, [&] {
+        token.clearEvents();
+        for (const auto& recipient : recipients) token.TransferEvent(sender, recipient, uint256_t(1));
+    });
+    bench("events/json_object_per_event", count, [&] {
+        json events = json::array();
+        for (const auto& event : token.events()) {
+            json eventJson;
+            event.to_json(eventJson);
+            events.push_back(std::move(eventJson));
+        }
+        doNotOptimize(events.size());
+    });
+    bench("events/airdrop_call", count, airdrop);
+
+    ContractOutputs output;
+    token.swapEvents(output.events);
+    std::string compact;
+    bench("events/serialize_compact_json", count, [&] {
+        compact.clear();
+        output.appendCompactJson(compact);
+        doNotOptimize(compact.data());
+    });
+    std::string binary;
+    bench("events/serialize_binary", count, [&] { binary = output.to_binary(); });
+
+    ContractOutputs decoded;
+    decoded.from_binary(binary);
+    if (output.events.size() != count || compact != output.to_json().dump() || decoded.to_json() != output.to_json()) {
+        std::fprintf(stderr, "event serialization mismatch\n");
+        std::abort();
+    }
+    report("events/per_call", static_cast<double>(count), "events");
+    report("events/compact_json_bytes", static_cast<double>(compact.size()), "bytes");
+    report("events/binary_bytes", static_cast<double>(binary.size()), "bytes");
+}
+
+void checkSameBatchLedger(const char* label, const ERC20& token, const ERC20& model,
+                          const std::vector<Erc20Payment>& payments) {
+    Address sender{};
+    sender.fill(0xAA);
+    bool same = token.totalSupply() == model.totalSupply() && token.holderCount() == model.holderCount() &&
+                token.balanceOf(sender) == model.balanceOf(sender);
+    for (const auto& payment : payments) same = same && token.balanceOf(payment.to) == model.balanceOf(payment.to);
+    if (!same) {
+        std::fprintf(stderr, "%s: batch and per-recipient ledgers differ\n", label);
+        std::abort();
+    }
+}
+
+// transferBatch/mintBatch must leave the same ledger as one call per
+// recipient, reject a batch without writing, and decode from every input format
+void checkTransferBatch(const std::vector<Address>& recipients) {
+    std::vector<Erc20Payment> payments;
+    for (std::size_t i = 0; i < recipients.size(); ++i) {
+        payments.push_back({recipients[i], uint256_t(static_cast<uint64_t>(i % 7))});
+        // Repeat every third recipient so merging is exercised
+        if (i % 3 == 0) payments.push_back({recipients[i], uint256_t(5)});
+    }
+    Address sender{};
+    sender.fill(0xAA);
+    payments.push_back({sender, uint256_t(11)});
+
+    ERC20 batched = fundedToken(), looped = fundedToken();
+    if (!batched.transferBatch(payments)) {
+        std::fprintf(stderr, "transferBatch failed: %s\n", erc20StatusMessage(batched.lastStatus()));
+        std::abort();
+    }
+    for (const auto& payment : payments) looped.transfer(payment.to, payment.value);
+    checkSameBatchLedger("transferBatch", batched, looped, payments);
+
+    ERC20 minted("MyToken", "MTK"), mintedLoop("MyToken", "MTK");
+    minted.mintBatch(payments);
+    for (const auto& payment : payments) mintedLoop.mint(payment.to, payment.value);
+    checkSameBatchLedger("mintBatch", minted, mintedLoop, payments);
+
+    const std::size_t changes = batched.changes().size(), events = batched.events().size();
+    std::vector<Erc20Payment> rejected = payments;
+    rejected.push_back({recipients.front(), batched.balanceOf(sender)});
+    const bool overdrawn = batched.transferBatch(rejected);
+    rejected.back() = {Address{}, uint256_t(1)};
+    const bool zeroReceiver = batched.transferBatch(rejected);
+    rejected.back() = {recipients.front(), Uint256::max()};
+    const bool overflowed = batched.transferBatch(rejected) || minted.mintBatch(rejected) == Erc20Status::Ok;
+    if (overdrawn || zeroReceiver || overflowed || batched.changes().size() != changes ||
+        batched.events().size() != events || minted.totalSupply() != mintedLoop.totalSupply()) {
+        std::fprintf(stderr, "rejected batch wrote state\n");
+        std::abort();
+    }
+
+    ComputeInputs call = ComputeInputs::parse(readFile("sample-contract-input2.json"));
+    call.contract_input.contract_fn = "transferBatch";
+    call.contract_input.function_inputs.erc20.transfer_batch.payments.assign(payments.begin(), payments.begin() + 10);
+    json expected;
+    call.contract_input.to_json(expected);
+    json document, fromText, fromDom, fromBinary;
+    call.to_json(document);
+    ComputeInputs::parse(document.dump()).contract_input.to_json(fromText);
+    ContractInputs dom;
+    dom.from_json(expected);
+    dom.to_json(fromDom);
+    ComputeInputs::from_binary(call.to_binary()).contract_input.to_json(fromBinary);
+    ERC20 token = fundedToken();
+    ContractOutputs output;
+    execute_erc20(token, call.contract_input, output);
+    const auto& result = std::get<Erc20Result>(output.result.result);
+    if (fromText != expected || fromDom != expected || fromBinary != expected ||
+        result.getType() != Erc20Result::Erc20ResultType::EnumTransferBatch || !result.success()) {
+        std::fprintf(stderr, "transferBatch inputs do not round trip\n");
+        std::abort();
+    }
+    // The record must not depend on where the recipients sit in the balance
+    // table: a token with a larger table, and one under another hash seed,
+    // emit the same bytes
+    call.contract_input.function_inputs.erc20.transfer_batch.payments = payments;
+    auto batchRecord = [&](ERC20& ledger, WireFormat format) {
+        ContractOutputs out;
+        out.format = format;
+        execute_erc20(ledger, call.contract_input, out);
+        std::string record;
+        out.appendRecord(record);
+        return record;
+    };
+    for (WireFormat format : {WireFormat::Json, WireFormat::Binary}) {
+        ERC20 small = fundedToken(), large = fundedToken();
+        for (const auto& filler : randomAddresses(50000, 41)) large.mint(filler, uint256_t(1));
+        large.takeChanges();
+        large.clearEvents();
+        const std::string expectedRecord = batchRecord(small, format);
+        const std::string largeRecord = batchRecord(large, format);
+        const uint64_t defaultSeed = AddressHash::seed;
+        AddressHash::randomizeSeed();
+        ERC20 reseeded = fundedToken();
+        const std::string reseededRecord = batchRecord(reseeded, format);
+        AddressHash::setSeed(defaultSeed);
+        if (largeRecord != expectedRecord || reseededRecord != expectedRecord) {
+            std::fprintf(stderr, "transferBatch output depends on the balance table\n");
+            std::abort();
+        }
+    }
+}
+
+// An airdrop of one unit to each recipient, first to new holders and then
+// again to the same (now existing) holders
+void benchTransferBatch(const std::vector<Address>& recipients) {
+    const std::size_t count = recipients.size();
+    std::vector<Erc20Payment> payments;
+    payments.reserve(count);
+    for (const auto& recipient : recipients) payments.push_back({recipient, uint256_t(1)});
+
+    ERC20 looped = fundedToken(), batched = fundedToken();
+    for (const char* pass : {"new", "existing"}) {
+        std::string label = "transfer_batch/" + std::to_string(count) + "_" + pass + "_transfer_loop";
+        bench(label.c_str(), count, [&] {
+            for (const auto& payment : payments) looped.transfer(payment.to, payment.value);
+        });
+        label = "transfer_batch/" + std::to_string(count) + "_" + pass + "_transfer_batch";
+        bench(label.c_str(), count, [&] { batched.transferBatch(payments); });
+        looped.takeChanges();
+        looped.clearEvents();
+        batched.takeChanges();
+        batched.clearEvents();
+    }
+    checkSameBatchLedger("airdrop", batched, looped, payments);
+
+    ERC20 mintedLoop("MyToken", "MTK"), minted("MyToken", "MTK");
+    std::string label = "transfer_batch/" + std::to_string(count) + "_mint_loop";
+    bench(label.c_str(), count, [&] {
+        for (const auto& payment : payments) mintedLoop.mint(payment.to, payment.value);
+    });
+    label = "transfer_batch/" + std::to_string(count) + "_mint_batch";
+    bench(label.c_str(), count, [&] { minted.mintBatch(payments); });
+    checkSameBatchLedger("mint airdrop", minted, mintedLoop, payments);
+}
+
+// Holders that each granted 0xAA an allowance, so transferFrom calls can
+// touch disjoint slots (transfer always debits the one fixed sender)
+ERC20 parallelLedger(const std::vector<Address>& holders) {
+    Address spender{};
+    spender.fill(0xAA);
+    std::vector<Erc20Payment> payments;
+    Erc20ChangeSet allowances;
+    for (const auto& holder : holders) {
+        payments.push_back({holder, uint256_t(1000)});
+        allowances.record(Erc20StateChange::Slot::Allowance, holder, spender, uint256_t(0), uint256_t(1000));
+    }
+    // Funds 0xAA too, which pays the transferBatch calls of parallelCalls
+    payments.push_back({spender, uint256_t(1000000)});
+    ERC20 token("MyToken", "MTK");
+    token.mintBatch(payments);
+    token.applyChanges(allowances);
+    token.takeChanges();
+    token.clearEvents();
+    return token;
+}
+
+// transfer, approve and transferFrom on a ledger of `holders` funded accounts,
+// visited in random order. Pending changes and events are dropped every
+// 1024 calls, as committing each call's output would.
+void benchErc20Calls(const std::vector<Address>& holders) {
+    Address sender{};
+    sender.fill(0xAA);
+    ERC20 token = parallelLedger(holders);
+    token.mint(sender, Uint256::fromLimbs(0, 0, 1, 0));
+
+    std::vector<std::size_t> order(holders.size());
+    for (std::size_t i = 0; i < order.size(); ++i) order[i] = i;
+    std::shuffle(order.begin(), order.end(), std::mt19937_64(7));
+
+    std::size_t failed = 0;
+    auto run = [&](const char* call, auto&& fn) {
+        token.takeChanges();
+        token.clearEvents();
+        bench("erc20/" + std::string(call) + "/holders_" + std::to_string(holders.size()), order.size(), [&] {
+            for (std::size_t i = 0; i < order.size(); ++i) {
+                failed += !fn(i);
+                if ((i & 1023) == 1023) {
+                    token.takeChanges();
+                    token.clearEvents();
+                }
+            }
+        });
+    };
+    run("transfer", [&](std::size_t i) { return token.transfer(holders[order[i]], uint256_t(1)); });
+    run("approve", [&](std::size_t i) { return token.approve(holders[order[i]], uint256_t(i + 1)); });
+    // Every holder granted 0xAA 1000 in parallelLedger
+    run("transfer_from", [&](std::size_t i) {
+        return token.transferFrom(holders[order[i]], holders[order[order.size() - 1 - i]], uint256_t(1));
+    });
+    if (failed) {
+        std::fprintf(stderr, "erc20 calls: %zu calls failed\n", failed);
+        std::abort();
+    }
+}
+
+// transferFrom calls between disjoint holders, with every 8th call an
+// approve and every 8th a transferBatch instead. With probability
+// conflictRate a call pays (or approves) the shared hot account, so it
+// depends on the hot call before it. Batches all pay from 0xAA and so
+// depend on each other whatever the rate.
+std::vector<ContractInputs> parallelCalls(const std::vector<Address>& holders, const std::vector<Address>& recipients,
+                                          double conflictRate) {
+    ComputeInputs call = ComputeInputs::parse(readFile("sample-contract-input2.json"));
+    Address hot{};
+    hot.fill(0x77);
+    std::mt19937_64 rng(7);
+    std::bernoulli_distribution conflict(conflictRate);
+    std::vector<ContractInputs> calls;
+    for (std::size_t i = 0; i < holders.size(); ++i) {
+        auto& inputs = call.contract_input.function_inputs.erc20;
+        const Address& to = conflict(rng) ? hot : recipients[i];
+        if (i % 8 == 2) {
+            // Two recipients and a repeat, so merging and credit order are covered
+            call.contract_input.contract_fn = "transferBatch";
+            inputs.transfer_batch.payments = {{to, uint256_t(1)}, {holders[i], uint256_t(2)},
+                                              {to, i % 32 == 10 ? Uint256::max() : uint256_t(4)}};
+        } else if (i % 8 == 5) {
+            call.contract_input.contract_fn = "approve";
+            inputs.approve.address = to;
+            inputs.approve.value = uint256_t(1 + i % 7);
+        } else {
+            call.contract_input.contract_fn = "transferFrom";
+            inputs.transfer_from.from = holders[i];
+            inputs.transfer_from.to = to;
+            // Every 16th call overdraws and fails, so rolled-back calls are covered too
+            inputs.transfer_from.value = uint256_t(i % 16 == 0 ? 5000 : 1 + i % 7);
+        }
+        calls.push_back(call.contract_input);
+    }
+    return calls;
+}
+
+// mintBatch is not a contract call, so the executor never runs it; check
+// the speculative path it would take instead: minting on a view must give
+// the same change records and events as minting on the token
+void checkSpeculativeMintBatch(const std::vector<Address>& holders, const std::vector<Address>& recipients) {
+    std::vector<Erc20Payment> payments;
+    for (std::size_t i = 0; i < holders.size(); ++i) {
+        payments.push_back({recipients[i], uint256_t(1 + i % 5)});
+        if (i % 3 == 0) payments.push_back({holders[i], uint256_t(2)});
+        if (i % 7 == 0) payments.push_back({recipients[i / 2], uint256_t(3)});
+    }
+    ERC20 token = parallelLedger(holders);
+    Erc20ReadSet reads;
+    ERC20 view = token.speculativeView(reads);
+    auto record = [&](ERC20& ledger) {
+        ContractOutputs out;
+        if (ledger.mintBatch(payments) != Erc20Status::Ok) std::abort();
+        out.stateDelta = ledger.takeChanges();
+        ledger.swapEvents(out.events);
+        std::string bytes;
+        out.appendRecord(bytes);
+        return bytes;
+    };
+    const std::string speculative = record(view);
+    if (speculative != record(token)) {
+        std::fprintf(stderr, "parallel/mint_batch: speculative mintBatch differs from the token's\n");
+        std::abort();
+    }
+}
+
+// Scaling of the optimistic executor over thread counts and conflict rates;
+// every run must produce the sequential outputs and ledger byte for byte
+void benchParallelExecution(const std::vector<Address>& holders, const std::vector<Address>& recipients) {
+    const std::size_t count = holders.size();
+    checkSpeculativeMintBatch(holders, recipients);
+    for (double conflictRate : {0.0, 0.1, 0.5, 1.0}) {
+        const auto calls = parallelCalls(holders, recipients, conflictRate);
+        const std::string rate = std::to_string(static_cast<int>(conflictRate * 100)) + "%";
+
+        ERC20 sequential = parallelLedger(holders);
+        std::vector<ContractOutputs> expected(count);
+        std::string label = "parallel/conflict_" + rate + "/sequential";
+        bench(label.c_str(), count, [&] {
+            for (std::size_t i = 0; i < count; ++i) {
+                try {
+                    execute_erc20(sequential, calls[i], expected[i]);
+                } catch (const std::exception& e) {
+                    expected[i].error = e.what();
+                }
+            }
+        });
+        std::string expectedRecords;
+        for (const auto& output : expected) output.appendRecord(expectedRecords);
+
+        for (unsigned threads : {1u, 2u, 4u, 8u, 16u, 32u}) {
+            ERC20 token = parallelLedger(holders);
+            Erc20ParallelExecutor executor(threads);
+            std::vector<ContractOutputs> outputs;
+            label = "parallel/conflict_" + rate + "/threads_" + std::to_string(threads);
+            bench(label.c_str(), count, [&] { executor.execute(token, calls, outputs); });
+
+            std::string records;
+            for (const auto& output : outputs) output.appendRecord(records);
+            Address hot{}, sender{};
+            hot.fill(0x77);
+            sender.fill(0xAA);
+            bool same = records == expectedRecords && token.totalSupply() == sequential.totalSupply() &&
+                        token.holderCount() == sequential.holderCount() &&
+                        token.allowanceCount() == sequential.allowanceCount() &&
+                        token.balanceOf(hot) == sequential.balanceOf(hot) &&
+                        token.balanceOf(sender) == sequential.balanceOf(sender) &&
+                        token.allowance(sender, hot) == sequential.allowance(sender, hot);
+            for (std::size_t i = 0; i < count && same; ++i) {
+                same = token.balanceOf(holders[i]) == sequential.balanceOf(holders[i]) &&
+                       token.balanceOf(recipients[i]) == sequential.balanceOf(recipients[i]) &&
+                       token.allowance(sender, recipients[i]) == sequential.allowance(sender, recipients[i]);
+            }
+            if (!same) {
+                std::fprintf(stderr, "%s: parallel execution differs from sequential\n", label.c_str());
+                std::abort();
+            }
+            if (threads == 2) {
+                report("parallel/conflict_" + rate + "/reexecuted", static_cast<double>(executor.reexecuted()),
+                       "calls", count);
+            }
+        }
+    }
+}
+
+double percentile(std::vector<double> samples, double fraction) {
+    std::sort(samples.begin(), samples.end());
+    return samples[std::min(samples.size() - 1, static_cast<std::size_t>(fraction * samples.size()))];
+}
+
+// Read throughput and writer latency with reader threads querying while
+// one writer commits transfers. Every read checks that the sender and the
+// recipients still hold the whole supply, which only a consistent version does.
+void benchConcurrentReads(std::size_t calls) {
+    Address sender{};
+    sender.fill(0xAA);
+    const auto recipients = randomAddresses(8, 9);
+    std::vector<ContractInputs> inputs;
+    ComputeInputs call = ComputeInputs::parse(readFile("sample-contract-input2.json"));
+    call.contract_input.contract_fn = "transfer";
+    for (std::size_t i = 0; i < calls; ++i) {
+        call.contract_input.function_inputs.erc20.transfer.address = recipients[i % recipients.size()];
+        call.contract_input.function_inputs.erc20.transfer.value = uint256_t(1 + i % 5);
+        inputs.push_back(call.contract_input);
+    }
+
+    std::vector<double> latencies(calls);
+    auto timeCall = [&](std::size_t i, auto&& execute) {
+        auto start = std::chrono::steady_clock::now();
+        execute();
+        latencies[i] = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count();
+    };
+    ERC20 plain = fundedToken();
+    for (std::size_t i = 0; i < calls; ++i) {
+        ContractOutputs output;
+        timeCall(i, [&] { execute_erc20(plain, inputs[i], output); });
+    }
+    report("concurrent/plain_erc20/writer_p50", percentile(latencies, 0.5), "ns");
+    report("concurrent/plain_erc20/writer_p99", percentile(latencies, 0.99), "ns");
+
+    // A write that throws must leave no trace on either copy: the next two
+    // writes publish each copy in turn
+    {
+        ConcurrentErc20 token([] { return fundedToken(); });
+        bool thrown = false;
+        try {
+            token.write([&](ERC20& ledger) {
+                ledger.mint(recipients.front(), uint256_t(5));
+                throw std::runtime_error("write failed");
+            });
+        } catch (const std::runtime_error&) {
+            thrown = true;
+        }
+        const uint256_t supply = plain.totalSupply();
+        for (uint64_t version = 1; version <= 2; ++version) {
+            token.write([&](ERC20& ledger) { ledger.mint(recipients.back(), uint256_t(1)); });
+            if (!thrown || token.version() != version || token.balanceOf(recipients.front()) != 0 ||
+                token.totalSupply() != supply + uint256_t(version)) {
+                std::fprintf(stderr, "concurrent: a failed write left changes behind\n");
+                std::abort();
+            }
+        }
+    }
+
+    for (unsigned readers : {1u, 2u, 4u, 8u}) {
+        ConcurrentErc20 token([] { return fundedToken(); });
+        std::atomic<bool> done{false};
+        std::atomic<uint64_t> reads{0};
+        std::atomic<bool> torn{false};
+        std::vector<std::thread> threads;
+        for (unsigned r = 0; r < readers; ++r) {
+            threads.emplace_back([&] {
+                uint64_t count = 0, lastVersion = 0;
+                while (!done.load(std::memory_order_relaxed)) {
+                    token.read([&](const ERC20& view, uint64_t version) {
+                        uint256_t held = view.balanceOf(sender);
+                        for (const auto& recipient : recipients) held += view.balanceOf(recipient);
+                        if (held != view.totalSupply() || version < lastVersion) torn = true;
+                        lastVersion = version;
+                    });
+                    ++count;
+                }
+                reads += count;
+            });
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        for (std::size_t i = 0; i < calls; ++i) {
+            ContractOutputs output;
+            timeCall(i, [&] { token.execute(inputs[i], output); });
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        done = true;
+        for (auto& thread : threads) thread.join();
+
+        if (torn || token.version() != calls || token.balanceOf(sender) != plain.balanceOf(sender)) {
+            std::fprintf(stderr, "concurrent reads saw an inconsistent ledger\n");
+            std::abort();
+        }
+        const std::string prefix = "concurrent/readers_" + std::to_string(readers);
+        report(prefix + "/reads", static_cast<double>(reads.load()) / seconds, "reads/sec");
+        report(prefix + "/writer_p50", percentile(latencies, 0.5), "ns");
+        report(prefix + "/writer_p99", percentile(latencies, 0.99), "ns");
+    }
+}
+
+void benchBatch(std::size_t calls) {
+    auto inputs = transferCalls(calls);
+
+    std::string lines;
+    for (const auto& call : inputs) {
+        json j;
+        call.to_json(j);
+        lines += j.dump();
+        lines += '\n';
+    }
+    benchBatchStream("newline_json", lines, calls);
+
+    std::string frames;
+    WireWriter w(frames);
+    w.writeBytes(WIRE_BATCH_MAGIC, sizeof(WIRE_BATCH_MAGIC));
+    w.writeU8(WIRE_FORMAT_VERSION);
+    for (const auto& call : inputs) {
+        std::string message = call.to_binary();
+        w.writeU32(static_cast<uint32_t>(message.size()));
+        w.writeBytes(message.data(), message.size());
+    }
+    benchBatchStream("length_prefixed_binary", frames, calls);
+
+#ifndef __EMSCRIPTEN__
+    benchProcessPerCall(lines.substr(0, lines.find('\n') + 1), std::min<std::size_t>(calls, 200));
+#endif
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    if (argc > 1 && std::strcmp(argv[1], "--contract") == 0) {
+        ERC20 token = fundedToken();
+        process_erc20(token);
+        return 0;
+    }
+
+    std::size_t holders = 1000000;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--json") == 0) {
+            g_jsonOutput = true;
+        } else {
+            holders = std::strtoull(argv[i], nullptr, 10);
+        }
+    }
+
+    auto addresses = randomAddresses(holders, 1);
+    auto strangers = randomAddresses(holders, 2);
+
+    benchBalanceMap<std::unordered_map<Address, uint256_t, LegacyAddressHash>>("unordered_map", addresses, strangers);
+    benchBalanceMap<FlatHashMap<Address, uint256_t, LegacyAddressHash>>("flat_hash_map", addresses, strangers);
+    benchBalanceMap<FlatHashMap<Address, uint256_t, AddressHash>>("flat_hash_map+address_hash", addresses, strangers);
+
+    auto prefixed = sharedPrefixAddresses(holders);
+    auto suffixed = sharedSuffixAddresses(holders);
+    benchHashQuality<LegacyAddressHash>("legacy", "random", addresses);
+    benchHashQuality<LegacyAddressHash>("legacy", "shared_prefix", prefixed);
+    benchHashQuality<LegacyAddressHash>("legacy", "shared_suffix", suffixed);
+    benchHashQuality<AddressHash>("address_hash", "random", addresses);
+    benchHashQuality<AddressHash>("address_hash", "shared_prefix", prefixed);
+    benchHashQuality<AddressHash>("address_hash", "shared_suffix", suffixed);
+
+    // Every shared-suffix address collides under the legacy hash, so keep that set small
+    auto flood = sharedSuffixAddresses(std::min<std::size_t>(holders, 20000));
+    benchAdversarialLookup<std::unordered_map<Address, uint256_t, LegacyAddressHash>>("legacy", "shared_suffix", flood);
+    benchAdversarialLookup<FlatHashMap<Address, uint256_t, AddressHash>>("address_hash", "shared_suffix", flood);
+
+    // Chosen against the hash's own constants, so it must spread under the default and a random seed alike
+    auto cancelling = keyCancelAddresses(std::min<std::size_t>(holders, 20000));
+    benchHashQuality<AddressHash>("address_hash", "key_cancel", cancelling);
+    benchAdversarialLookup<FlatHashMap<Address, uint256_t, AddressHash>>("address_hash", "key_cancel", cancelling);
+    const uint64_t defaultSeed = AddressHash::seed;
+    AddressHash::randomizeSeed();
+    benchHashQuality<AddressHash>("address_hash+random_seed", "key_cancel", cancelling);
+    benchAdversarialLookup<FlatHashMap<Address, uint256_t, AddressHash>>("address_hash+random_seed", "key_cancel",
+                                                                        cancelling);
+    AddressHash::setSeed(defaultSeed);
+
+    for (std::size_t spendersPerOwner : {1, 4}) {
+        benchAllowances<NestedAllowances>("nested_unordered_map", addresses, strangers, spendersPerOwner);
+        benchAllowances<TokenAllowances>("erc20_flat_composite_key", addresses, strangers, spendersPerOwner);
+    }
+
+    benchTokenApprove(strangers);
+    checkForEachAllowance(20000);
+
+    benchStateSpam(addresses, strangers);
+    fuzzLedger(200000);
+
+    auto lhs = randomUint256s(holders, 3);
+    auto rhs = randomUint256s(holders, 4);
+    std::vector<boost::multiprecision::uint256_t> boostLhs, boostRhs;
+    for (const auto& value : lhs) boostLhs.push_back(toBoost(value));
+    for (const auto& value : rhs) boostRhs.push_back(toBoost(value));
+    benchUint256("boost", boostLhs, boostRhs);
+    benchUint256("native", lhs, rhs);
+
+    benchHexCodec(addresses, lhs);
+    benchAddressValidation(addresses);
+
+    benchInputDecode("sample_input", readFile("sample-contract-input.json"), 20000);
+    benchInputDecode("sample_input2", readFile("sample-contract-input2.json"), 20000);
+    std::vector<Address> recipients(addresses.begin(), addresses.begin() + std::min<std::size_t>(holders, 10000));
+    benchInputDecode("generated_10k_recipients", generatedInput(recipients), 20);
+
+    checkOutputWireRoundTrip();
+    benchWireFormat("sample_input", readFile("sample-contract-input.json"), 20000);
+    benchWireFormat("sample_input2", readFile("sample-contract-input2.json"), 20000);
+    benchWireFormat("generated_10k_recipients", generatedInput(recipients), 20);
+    benchOutputCommit(200000);
+    benchResults(1000000);
+    benchDispatch(1000000);
+    benchTokenInterface(std::vector<Address>(addresses.begin(), addresses.begin() + std::min<std::size_t>(holders, 10000)),
+                        100);
+    checkFailedCallRollback();
+    checkErc721Indexes(200000);
+    checkErc721Calls();
+    benchErc721(holders);
+    benchEvents(std::vector<Address>(addresses.begin(), addresses.begin() + std::min<std::size_t>(holders, 10000)));
+    checkTransferBatch(std::vector<Address>(addresses.begin(), addresses.begin() + std::min<std::size_t>(holders, 1000)));
+    for (std::size_t recipients : {10000, 100000, 1000000}) {
+        if (recipients > holders) break;
+        benchTransferBatch(std::vector<Address>(addresses.begin(), addresses.begin() + recipients));
+    }
+    for (std::size_t count : {1000, 100000, 1000000}) {
+        if (count > holders) break;
+        benchErc20Calls(std::vector<Address>(addresses.begin(), addresses.begin() + count));
+    }
+    benchBatch(std::min<std::size_t>(holders, 100000));
+#ifndef __EMSCRIPTEN__
+    const std::size_t parallelCallCount = std::min<std::size_t>(holders, 50000);
+    benchParallelExecution(std::vector<Address>(addresses.begin(), addresses.begin() + parallelCallCount),
+                           std::vector<Address>(strangers.begin(), strangers.begin() + parallelCallCount));
+    benchConcurrentReads(std::min<std::size_t>(holders, 2000));
+#endif
+    benchSnapshot(addresses);
+    benchJournal(std::vector<Address>(addresses.begin(), addresses.begin() + std::min<std::size_t>(holders, 1000)),
+                 100000);
+
+    return 0;
+}
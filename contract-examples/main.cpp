@@ -1,10 +1,76 @@
-
 #include "../src/versatus_cpp.hpp"
 #include "../src/versatus_cpp_erc20.hpp"
+#include "../src/versatus_cpp_erc721.hpp"
+
+#ifdef VERSATUS_STATS
+#include <cstdlib>
+#include <new>
+
+// Feeds the allocation count of the stats record
+void* operator new(std::size_t size) {
+    VERSATUS_STATS_COUNT(Allocations, 1);
+    if (void* block = std::malloc(size ? size : 1)) return block;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* ptr) noexcept {
+    std::free(ptr);
+}
+
+void operator delete(void* ptr, std::size_t) noexcept {
+    std::free(ptr);
+}
+#endif
+
+// Minted to 0xAA..AA before the first call; covers the sample inputs' transfers
+constexpr uint64_t EXAMPLE_SUPPLY = 1000000;
 
-int main() {
+int main(int argc, char** argv) {
 
-    process_erc20();
+    bool batch = false;
+    bool erc721 = false;
+    const char* statePath = nullptr;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--batch") == 0) {
+            batch = true;
+        } else if (std::strcmp(argv[i], "--erc721") == 0) {
+            erc721 = true;
+        } else if (std::strcmp(argv[i], "--state") == 0 && i + 1 < argc) {
+            statePath = argv[++i];
+        }
+    }
+
+    // `--erc721` runs the call against an example collection instead of the token
+    if (erc721) {
+        Address owner{};
+        owner.fill(0xAA);
+        ERC721 myCollection("MyCollection", "MCL");
+        for (uint64_t tokenId = 1; tokenId <= 3; ++tokenId) myCollection.mint(owner, tokenId);
+        process_erc721(myCollection);
+        return 0;
+    }
+
+    // `--state <file>` carries the ledger across runs: mapped if the file
+    // exists, seeded with the example mint otherwise, and saved at exit
+    if (statePath) {
+        Address owner{};
+        owner.fill(0xAA);
+        const bool saved = ::access(statePath, F_OK) == 0;
+        ERC20 myToken = saved ? ERC20(Erc20Snapshot::open(statePath)) : ERC20("MyToken", "MTK");
+        // A saved ledger is used as-is, even if its supply was burned to zero
+        if (!saved) myToken.mint(owner, EXAMPLE_SUPPLY);
+        // The seed mint is not part of the first call's state delta
+        myToken.takeChanges();
+
+        if (batch) {
+            std::ios::sync_with_stdio(false);
+            process_erc20_batch(myToken);
+        } else {
+            process_erc20(myToken);
+        }
+        myToken.saveSnapshot(statePath);
+        return 0;
+    }
 
     // Create an instance of ERC20
     ERC20 myToken("MyToken", "MTK");
@@ -12,11 +78,25 @@ int main() {
     Address owner{};
     owner.fill(0xAA);
 
-    myToken.mint(owner, 10000);
+    // Minted before any call runs, so the example calls have a supply to move
+    myToken.mint(owner, EXAMPLE_SUPPLY);
+    // The seed mint is not part of the first call's state delta
+    myToken.takeChanges();
+
+    // `--batch` keeps the token alive across every call read from stdin
+    if (batch) {
+        std::ios::sync_with_stdio(false);
+        process_erc20_batch(myToken);
+        return 0;
+    }
+
+    process_erc20(myToken);
 
-    // Example usage
-    std::cout << "Total Supply: " << myToken.totalSupply() << std::endl;
-    std::cout << "Balance of my Address: " << addressToString(owner) << " is : " << myToken.balanceOf(owner) << std::endl;
+    // Example usage; production output must stay a single result record
+    if (debugOutput()) {
+        std::cout << "Total Supply: " << myToken.totalSupply() << std::endl;
+        std::cout << "Balance of my Address: " << addressToString(owner) << " is : " << myToken.balanceOf(owner) << std::endl;
+    }
 
     return 0;
-}
\ No newline at end of file
+}
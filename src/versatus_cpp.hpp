@@ -5,11 +5,32 @@
 #include <string>
 #include <vector>
 #include <map>
+#include <algorithm>
+#include <cmath>
 #include <nlohmann/json.hpp>
-#include <boost/multiprecision/cpp_int.hpp>
 #include <cassert>
+#include <cstring>
+#include <iomanip>
+#include <random>
+#include <sstream>
+#include <type_traits>
+
+#include "./versatus_cpp_uint256.hpp"
+#include "./versatus_cpp_hex.hpp"
+#include "./versatus_cpp_wire.hpp"
+#include "./versatus_cpp_stats.hpp"
+
+// Define VERSATUS_USE_BOOST_UINT256 to build against boost's cpp_int instead of Uint256
+#ifdef VERSATUS_USE_BOOST_UINT256
+#include <boost/multiprecision/cpp_int.hpp>
+#endif
 
 #include <stdexcept>
+#include <string_view>
+#include <system_error>
+#include <cerrno>
+#include <poll.h>
+#include <unistd.h>
 
 using namespace std;
 using json = nlohmann::json;
@@ -17,9 +38,116 @@ using json = nlohmann::json;
 // Assumption: Eth Address is 20 bytes
 constexpr std::size_t ADDRESS_SIZE = 20;
 using Address = std::array<uint8_t, ADDRESS_SIZE>;
+#ifdef VERSATUS_USE_BOOST_UINT256
 using uint256_t = boost::multiprecision::uint256_t;
+
+// Overflow-reporting arithmetic matching the Uint256 friends
+inline bool addOverflow(const uint256_t& a, const uint256_t& b, uint256_t& out) {
+    out = a + b;
+    return out < a;
+}
+
+inline bool subOverflow(const uint256_t& a, const uint256_t& b, uint256_t& out) {
+    bool borrow = a < b;
+    out = a - b;
+    return borrow;
+}
+#else
+using uint256_t = Uint256;
+#endif
 const int CUSTOM_INDENT_SPACES = 2;
 
+// Production commits one compact result record and nothing else; Debug keeps
+// the labelled, indented output and echoes the decoded inputs. Builds default
+// to Production unless VERSATUS_DEBUG_OUTPUT is defined.
+enum class OutputMode {
+    Production,
+    Debug
+};
+
+#ifdef VERSATUS_DEBUG_OUTPUT
+inline OutputMode output_mode = OutputMode::Debug;
+#else
+inline OutputMode output_mode = OutputMode::Production;
+#endif
+
+inline bool debugOutput() {
+    return output_mode == OutputMode::Debug;
+}
+
+// Writes the whole record with write(2), resuming after short writes and
+// interrupts and waiting out a full non-blocking pipe. Any other failure
+// throws std::system_error, so a record is never dropped silently.
+inline void writeOutput(const char* data, size_t size, int fd = STDOUT_FILENO) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK) {
+                pollfd ready{fd, POLLOUT, 0};
+                if (::poll(&ready, 1, -1) >= 0 || errno == EINTR) continue;
+            }
+            throw std::system_error(errno, std::generic_category(), "Cannot write contract output");
+        }
+        if (written == 0) throw std::runtime_error("Cannot write contract output: no progress");
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+}
+
+// 64x64 -> 128 bit multiply folded back to 64 bits; the core mixing step of the address hash
+inline uint64_t hashMix(uint64_t a, uint64_t b) {
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+    return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+#else
+    uint64_t aLo = a & 0xffffffff, aHi = a >> 32;
+    uint64_t bLo = b & 0xffffffff, bHi = b >> 32;
+    uint64_t lo = aLo * bLo, mid1 = aHi * bLo, mid2 = aLo * bHi, hi = aHi * bHi;
+    uint64_t cross = (lo >> 32) + (mid1 & 0xffffffff) + mid2;
+    hi += (mid1 >> 32) + (cross >> 32);
+    return ((cross << 32) | (lo & 0xffffffff)) ^ hi;
+#endif
+}
+
+// Hash for Address keys shared by the token maps.
+// All 20 bytes are loaded as 8 + 8 + 4 byte words and folded through two
+// multiply-mix rounds, so every byte affects every output bit. The seed is
+// fixed by default so runs are reproducible; hosts exposed to chosen
+// addresses can call randomizeSeed() before any map is populated.
+struct AddressHash {
+    static inline uint64_t seed = 0x243f6a8885a308d3;
+
+    static void setSeed(uint64_t newSeed) {
+        seed = newSeed;
+    }
+
+    static void randomizeSeed() {
+        std::random_device rd;
+        seed = (static_cast<uint64_t>(rd()) << 32) ^ rd();
+    }
+
+    static constexpr uint64_t kP0 = 0xa0761d6478bd642f;
+    static constexpr uint64_t kP1 = 0xe7037ed1a0b428db;
+    static constexpr uint64_t kP2 = 0x8ebc6af09c88c6e3;
+
+    // Both operands of the first round are keyed: with a fixed one, a word
+    // equal to its constant would zero the product whatever the seed
+    static uint64_t hashWords(uint64_t w0, uint64_t w1, uint64_t w2) {
+        uint64_t h = hashMix(w0 ^ seed ^ kP0, w1 ^ seed ^ kP1);
+        return hashMix(h ^ w2 ^ kP2, seed ^ kP0);
+    }
+
+    size_t operator()(const Address& addr) const {
+        uint64_t w0, w1;
+        uint32_t w2;
+        std::memcpy(&w0, addr.data(), 8);
+        std::memcpy(&w1, addr.data() + 8, 8);
+        std::memcpy(&w2, addr.data() + 16, 4);
+        return static_cast<size_t>(hashWords(w0, w1, w2));
+    }
+};
+
 // Generic function to print an object to JSON string
 template <typename T>
 std::string print_json(const T& obj) {
@@ -29,52 +157,146 @@ std::string print_json(const T& obj) {
 }
 
 std::string uint256_to_hex(const uint256_t& value) {
+#ifdef VERSATUS_USE_BOOST_UINT256
     std::stringstream ss;
     ss << std::hex << value;
     return ss.str();
+#else
+    char buffer[UINT256_HEX_DIGITS];
+    return std::string(buffer, uint256ToHex(value, buffer));
+#endif
 }
 
-// Converts string to Eth address of ADDRESS_SIZE bytes
-Address convertStringToAddress(const std::string& account_address) {
-    try {
-        // Check if the address starts with "0x"
-        if (account_address.size() >= 2 && account_address.substr(0, 2) == "0x") {
-            // Remove the "0x" prefix
-            auto hex_value = account_address.substr(2);
-
-            // Ensure the hex value length is valid
-            if (hex_value.size() > (ADDRESS_SIZE * 2)) {
-                throw std::length_error("Input address string is too long");
-            }
+// Appends the hex digits of value (no prefix) without a temporary string
+void appendUint256Hex(std::string& out, const uint256_t& value) {
+#ifdef VERSATUS_USE_BOOST_UINT256
+    out += uint256_to_hex(value);
+#else
+    char buffer[UINT256_HEX_DIGITS];
+    out.append(buffer, uint256ToHex(value, buffer));
+#endif
+}
 
-            Address result{};
+// Parses a "0x" hex or decimal uint256 field; throws std::invalid_argument when malformed
+uint256_t parseUint256(std::string_view text) {
+#ifndef VERSATUS_USE_BOOST_UINT256
+    uint256_t value;
+    if (text.size() > 2 && text[0] == '0' && text[1] == 'x' && hexToUint256(text.data() + 2, text.size() - 2, value)) {
+        return value;
+    }
+    return uint256_t(text);
+#else
+    return uint256_t(std::string(text));
+#endif
+}
 
-            for (std::size_t i = 0; i < result.size(); ++i) {
-                std::string byte_str = hex_value.substr(i * 2, 2);
-                result[i] = static_cast<uint8_t>(std::stoi(byte_str, nullptr, 16));
-            }
+// Native Uint256 limbs of a uint256_t, for fixed-layout storage; identities
+// unless built against boost
+#ifdef VERSATUS_USE_BOOST_UINT256
+inline uint256_t fromNativeUint256(const Uint256& value) {
+    uint256_t result = 0;
+    for (std::size_t i = Uint256::kLimbs; i-- > 0;) result = (result << 64) | value.limb(i);
+    return result;
+}
 
-            return result;
-        } else {
-            throw std::invalid_argument("Input address string must start with '0x'");
-        }
-    } catch (const std::exception& e) {
-        std::cerr << "ERROR Address parse: " << e.what() << " for " << account_address << std::endl;
-        assert(0);
-        // Return the magic address in case of an exception
-        return Address{0xDE, 0xAD, 0xBE, 0xEF};
+inline Uint256 toNativeUint256(const uint256_t& value) {
+    const uint256_t mask = ~uint64_t(0);
+    return Uint256::fromLimbs(static_cast<uint64_t>(value & mask), static_cast<uint64_t>((value >> 64) & mask),
+                              static_cast<uint64_t>((value >> 128) & mask), static_cast<uint64_t>(value >> 192));
+}
+#else
+inline const Uint256& fromNativeUint256(const Uint256& value) {
+    return value;
+}
+
+inline const Uint256& toNativeUint256(const Uint256& value) {
+    return value;
+}
+#endif
+
+// uint256_t on the wire; converts through Uint256 when built against boost
+void writeWireUint256(WireWriter& w, const uint256_t& value) {
+#ifdef VERSATUS_USE_BOOST_UINT256
+    w.writeUint256(Uint256(std::string("0x") + uint256_to_hex(value)));
+#else
+    w.writeUint256(value);
+#endif
+}
+
+uint256_t readWireUint256(WireReader& r) {
+#ifdef VERSATUS_USE_BOOST_UINT256
+    return uint256_t(std::string("0x") + r.readUint256().toHex());
+#else
+    return r.readUint256();
+#endif
+}
+
+// "0x" followed by two hex digits per address byte
+constexpr std::size_t ADDRESS_HEX_LENGTH = 2 + ADDRESS_SIZE * 2;
+
+// Writes the ADDRESS_HEX_LENGTH characters of an address into out (not terminated)
+void addressToHex(const Address& address, char* out) {
+    out[0] = '0';
+    out[1] = 'x';
+    hexEncode(address.data(), ADDRESS_SIZE, out + 2);
+}
+
+enum class AddressParseError : uint8_t {
+    Ok,
+    MissingPrefix,
+    BadLength,
+    BadCharacter
+};
+
+const char* addressParseErrorMessage(AddressParseError error) {
+    switch (error) {
+        case AddressParseError::Ok: return "ok";
+        case AddressParseError::MissingPrefix: return "address must start with '0x'";
+        case AddressParseError::BadLength: return "address must have exactly 40 hex digits";
+        case AddressParseError::BadCharacter: return "address contains a non-hex character";
     }
+    return "unknown address error";
 }
 
-std::string addressToString(const Address& address) {
-    std::stringstream ss;
-    ss << "0x"; // Add "0x" at the beginning
+// Validating parse of "0x" + 40 hex digits. Never throws or allocates, and
+// leaves out untouched on error, so bulk validation stays cheap.
+AddressParseError parseAddress(std::string_view text, Address& out) {
+    if (text.size() < 2 || text[0] != '0' || text[1] != 'x') {
+        return AddressParseError::MissingPrefix;
+    }
+    if (text.size() != ADDRESS_HEX_LENGTH) {
+        return AddressParseError::BadLength;
+    }
+    Address result;
+    if (!hexDecode(text.data() + 2, ADDRESS_SIZE, result.data())) {
+        return AddressParseError::BadCharacter;
+    }
+    out = result;
+    return AddressParseError::Ok;
+}
+
+bool isValidAddress(std::string_view text) {
+    Address ignored;
+    return parseAddress(text, ignored) == AddressParseError::Ok;
+}
 
-    for (const auto& byte : address) {
-        ss << std::hex << std::setw(2) << std::setfill('0') << static_cast<int>(byte);
+// Converts string to Eth address of ADDRESS_SIZE bytes.
+// Throws std::invalid_argument like the JSON accessors it is used alongside;
+// use parseAddress to validate without exceptions.
+Address convertStringToAddress(const std::string& account_address) {
+    Address result;
+    AddressParseError error = parseAddress(account_address, result);
+    if (error != AddressParseError::Ok) {
+        throw std::invalid_argument(std::string("Invalid address ") + account_address + ": " +
+                                    addressParseErrorMessage(error));
     }
-    ss << std::dec;
-    return ss.str();
+    return result;
+}
+
+std::string addressToString(const Address& address) {
+    char buffer[ADDRESS_HEX_LENGTH];
+    addressToHex(address, buffer);
+    return std::string(buffer, ADDRESS_HEX_LENGTH);
 }
 
 class Input {
@@ -89,6 +311,14 @@ public:
         // Base class implementation (empty)
     }
 
+    virtual void to_wire(WireWriter& w) const {
+        // Base class implementation (empty)
+    }
+
+    virtual void from_wire(WireReader& r) {
+        // Base class implementation (empty)
+    }
+
     std::string print_json() const {
         json j;
         to_json(j);
@@ -103,7 +333,7 @@ class ApplicationInputs {
 
 public:
     std::string contract_fn;
-    uint64_t amount;
+    uint64_t amount = 0;
     std::vector<std::string> recipients;
 
     // Custom serialization function for ApplicationInputs
@@ -120,6 +350,21 @@ public:
         j.at(recipientsStr).get_to(recipients);
     }
 
+    void to_wire(WireWriter& w) const {
+        w.writeString(contract_fn);
+        w.writeU64(amount);
+        w.writeU32(static_cast<uint32_t>(recipients.size()));
+        for (const auto& recipient : recipients) w.writeString(recipient);
+    }
+
+    void from_wire(WireReader& r) {
+        contract_fn = r.readString();
+        amount = r.readU64();
+        uint32_t count = r.readU32();
+        recipients.clear();
+        for (uint32_t i = 0; i < count; ++i) recipients.push_back(r.readString());
+    }
+
     std::string print_json() const {
         json j;
         to_json(j);
@@ -139,6 +384,14 @@ public:
     void from_json(const json& j) override {
         j.at("value").get_to(value);
     }
+
+    void to_wire(WireWriter& w) const override {
+        w.writeString(value);
+    }
+
+    void from_wire(WireReader& r) override {
+        value = r.readString();
+    }
 };
 
 class SymbolInput : public Input {
@@ -153,11 +406,19 @@ public:
     void from_json(const json& j) override {
         j.at("value").get_to(value);
     }
+
+    void to_wire(WireWriter& w) const override {
+        w.writeString(value);
+    }
+
+    void from_wire(WireReader& r) override {
+        value = r.readString();
+    }
 };
 
 class DecimalsInput : public Input {
 public:
-    uint8_t value;
+    uint8_t value = 0;
 
     void to_json(json& j) const override {
         j = json{{"value", value}};
@@ -166,6 +427,14 @@ public:
     void from_json(const json& j) override {
         j.at("value").get_to(value);
     }
+
+    void to_wire(WireWriter& w) const override {
+        w.writeU8(value);
+    }
+
+    void from_wire(WireReader& r) override {
+        value = r.readU8();
+    }
 };
 
 class TotalSupplyInput : public Input {
@@ -178,7 +447,15 @@ public:
 
     void from_json(const json& j) override {
         std::string value_str = j.at("value");
-        value = boost::multiprecision::uint256_t(value_str);
+        value = uint256_t(value_str);
+    }
+
+    void to_wire(WireWriter& w) const override {
+        writeWireUint256(w, value);
+    }
+
+    void from_wire(WireReader& r) override {
+        value = readWireUint256(r);
     }
 };
 
@@ -195,6 +472,14 @@ public:
         account = convertStringToAddress(account_str);
     }
 
+    void to_wire(WireWriter& w) const override {
+        w.writeArray(account);
+    }
+
+    void from_wire(WireReader& r) override {
+        r.readArray(account);
+    }
+
 };
 
 class AllowanceInput : public Input {
@@ -215,6 +500,16 @@ public:
         spender = convertStringToAddress(spender_str);
     }
 
+    void to_wire(WireWriter& w) const override {
+        w.writeArray(owner);
+        w.writeArray(spender);
+    }
+
+    void from_wire(WireReader& r) override {
+        r.readArray(owner);
+        r.readArray(spender);
+    }
+
 };
 
 class TransferInput : public Input {
@@ -232,7 +527,17 @@ public:
         std::string address_str = j.at("address");
         address = convertStringToAddress(address_str);
         std::string value_str = j.at("value");
-        value = boost::multiprecision::uint256_t(value_str);
+        value = uint256_t(value_str);
+    }
+
+    void to_wire(WireWriter& w) const override {
+        w.writeArray(address);
+        writeWireUint256(w, value);
+    }
+
+    void from_wire(WireReader& r) override {
+        r.readArray(address);
+        value = readWireUint256(r);
     }
 
 };
@@ -255,7 +560,64 @@ public:
         std::string to_str = j.at("to");
         to = convertStringToAddress(to_str);
         std::string value_str = j.at("value");
-        value = boost::multiprecision::uint256_t(value_str);
+        value = uint256_t(value_str);
+    }
+
+    void to_wire(WireWriter& w) const override {
+        w.writeArray(from);
+        w.writeArray(to);
+        writeWireUint256(w, value);
+    }
+
+    void from_wire(WireReader& r) override {
+        r.readArray(from);
+        r.readArray(to);
+        value = readWireUint256(r);
+    }
+
+};
+
+// One recipient of a batched transfer or mint
+struct Erc20Payment {
+    Address to{};
+    uint256_t value;
+};
+
+class TransferBatchInput : public Input {
+public:
+    std::vector<Erc20Payment> payments;
+
+    // A JSON array of {"address", "value"} objects, the keys of TransferInput
+    void to_json(json& j) const override {
+        j = json::array();
+        for (const auto& payment : payments) {
+            j.push_back(json{{"address", addressToString(payment.to)}, {"value", "0x" + uint256_to_hex(payment.value)}});
+        }
+    }
+
+    void from_json(const json& j) override {
+        payments.clear();
+        payments.reserve(j.size());
+        for (const auto& entry : j) {
+            payments.push_back({convertStringToAddress(entry.at("address").get<std::string>()),
+                                parseUint256(entry.at("value").get<std::string>())});
+        }
+    }
+
+    void to_wire(WireWriter& w) const override {
+        w.writeU32(static_cast<uint32_t>(payments.size()));
+        for (const auto& payment : payments) {
+            w.writeArray(payment.to);
+            writeWireUint256(w, payment.value);
+        }
+    }
+
+    void from_wire(WireReader& r) override {
+        payments.resize(r.readCount(ADDRESS_SIZE + 32));
+        for (auto& payment : payments) {
+            r.readArray(payment.to);
+            payment.value = readWireUint256(r);
+        }
     }
 
 };
@@ -275,7 +637,17 @@ public:
         std::string address_str = j.at("address");
         address = convertStringToAddress(address_str);
         std::string value_str = j.at("value");
-        value = boost::multiprecision::uint256_t(value_str);
+        value = uint256_t(value_str);
+    }
+
+    void to_wire(WireWriter& w) const override {
+        w.writeArray(address);
+        writeWireUint256(w, value);
+    }
+
+    void from_wire(WireReader& r) override {
+        r.readArray(address);
+        value = readWireUint256(r);
     }
 
 };
@@ -292,13 +664,15 @@ public:
     TransferFromInput transfer_from;
     ApproveInput approve;
     AllowanceInput allowance;
+    TransferBatchInput transfer_batch;
 
     ERC20Inputs()
         : name(), symbol(), decimals(), total_supply(), balance_of(),
-          transfer(), transfer_from(), approve(), allowance() {}
+          transfer(), transfer_from(), approve(), allowance(), transfer_batch() {}
 
     // Custom serialization function for ERC20Inputs
     void to_json(json& j) const override {
+        j = json::object();
         if (!name.value.empty()) name.to_json(j);
         if (!symbol.value.empty()) symbol.to_json(j);
         if (decimals.value) decimals.to_json(j);
@@ -324,6 +698,7 @@ public:
             allowance.to_json(allowanceJson);
             j["allowance"] = allowanceJson;
         }
+        if (!transfer_batch.payments.empty()) transfer_batch.to_json(j["transferBatch"]);
 
     }
 
@@ -343,214 +718,1036 @@ public:
         }
         if (j.find("approve") != j.end()) approve.from_json(j.at("approve"));
         if (j.find("allowance") != j.end()) allowance.from_json(j.at("allowance"));
+        if (j.find("transferBatch") != j.end()) transfer_batch.from_json(j.at("transferBatch"));
+    }
+
+    // Fixed layout: every function's inputs are always present
+    void to_wire(WireWriter& w) const override {
+        name.to_wire(w);
+        symbol.to_wire(w);
+        decimals.to_wire(w);
+        total_supply.to_wire(w);
+        balance_of.to_wire(w);
+        transfer.to_wire(w);
+        transfer_from.to_wire(w);
+        approve.to_wire(w);
+        allowance.to_wire(w);
+        transfer_batch.to_wire(w);
+    }
+
+    void from_wire(WireReader& r) override {
+        name.from_wire(r);
+        symbol.from_wire(r);
+        decimals.from_wire(r);
+        total_supply.from_wire(r);
+        balance_of.from_wire(r);
+        transfer.from_wire(r);
+        transfer_from.from_wire(r);
+        approve.from_wire(r);
+        allowance.from_wire(r);
+        transfer_batch.from_wire(r);
     }
 
 };
 
-class FunctionInputs : public Input {
+class Erc721OwnerInput : public Input {
 public:
-    ERC20Inputs erc20;
+    Address owner{};
 
-    // Custom serialization function for FunctionInputs
     void to_json(json& j) const override {
-        json erc20Json;
-        erc20.to_json(erc20Json);
-        j["erc20"] = erc20Json;
+        j = json{{"owner", addressToString(owner)}};
     }
 
-    // Custom deserialization function for FunctionInputs
     void from_json(const json& j) override {
-        if (j.find("erc20") != j.end()) {
-            erc20.from_json(j.at("erc20"));
-        }
+        owner = convertStringToAddress(j.at("owner").get<std::string>());
     }
 
+    void to_wire(WireWriter& w) const override {
+        w.writeArray(owner);
+    }
+
+    void from_wire(WireReader& r) override {
+        r.readArray(owner);
+    }
 };
 
-class ContractInputs : public Input {
+class TokenIdInput : public Input {
 public:
-    std::string contract_fn;
-    FunctionInputs function_inputs;
+    uint256_t token_id;
 
-    // Custom serialization function for ContractInput
     void to_json(json& j) const override {
-        j["contractFn"] = contract_fn;
-
-        json functionInputsJson;
-        function_inputs.to_json(functionInputsJson);
-        j["functionInputs"] = functionInputsJson;
+        j = json{{"tokenId", "0x" + uint256_to_hex(token_id)}};
     }
 
-    // Custom deserialization function for ContractInput
     void from_json(const json& j) override {
-        j.at("contractFn").get_to(contract_fn);
-        function_inputs.from_json(j.at("functionInputs"));
+        token_id = parseUint256(j.at("tokenId").get<std::string>());
+    }
+
+    void to_wire(WireWriter& w) const override {
+        writeWireUint256(w, token_id);
     }
 
+    void from_wire(WireReader& r) override {
+        token_id = readWireUint256(r);
+    }
 };
 
-struct Erc20TransferEvent {
-    Address from;
-    Address to;
-    uint256_t value;
+class IsApprovedForAllInput : public Input {
+public:
+    Address owner{};
+    Address operator_address{};
 
-    Erc20TransferEvent& operator=(const Erc20TransferEvent& other) {
-        if (this != &other) {
-            from = other.from;
-            to = other.to;
-            value = other.value;
-        }
-        return *this;
+    void to_json(json& j) const override {
+        j = json{{"owner", addressToString(owner)}, {"operator", addressToString(operator_address)}};
     }
-};
 
-struct Erc20ApprovalEvent {
-    Address owner;
-    Address spender;
-    uint256_t value;
+    void from_json(const json& j) override {
+        owner = convertStringToAddress(j.at("owner").get<std::string>());
+        operator_address = convertStringToAddress(j.at("operator").get<std::string>());
+    }
 
-    Erc20ApprovalEvent& operator=(const Erc20ApprovalEvent& other) {
-        if (this != &other) {
-            owner = other.owner;
-            spender = other.spender;
-            value = other.value;
-        }
-        return *this;
+    void to_wire(WireWriter& w) const override {
+        w.writeArray(owner);
+        w.writeArray(operator_address);
     }
-};
 
-#include <variant>
+    void from_wire(WireReader& r) override {
+        r.readArray(owner);
+        r.readArray(operator_address);
+    }
+};
 
-class Erc20Result {
+class Erc721ApproveInput : public Input {
 public:
-    enum class Erc20ResultType {
-        EnumName,
-        EnumSymbol,
-        EnumDecimals,
-        EnumTotalSupply,
-        EnumBalanceOf,
-        EnumTransfer,
-        EnumTransferFrom,
-        EnumApprove,
-        EnumAllowance,
-        EnumUnknown
-    };
+    Address to{};
+    uint256_t token_id;
 
-    union Erc20ResultValue {
-        std::string name;
-        std::string symbol;
-        uint8_t decimals;
-        uint256_t totalSupply;
-        uint256_t balance;
-        Erc20TransferEvent transfer;
-        Erc20TransferEvent transferFrom;
-        Erc20ApprovalEvent approve;
-        bool success;
-        uint256_t remaining;
+    void to_json(json& j) const override {
+        j = json{{"to", addressToString(to)}, {"tokenId", "0x" + uint256_to_hex(token_id)}};
+    }
 
-        Erc20ResultValue() {}  // Default constructor for the union
-        ~Erc20ResultValue() {} // Destructor for the union
+    void from_json(const json& j) override {
+        to = convertStringToAddress(j.at("to").get<std::string>());
+        token_id = parseUint256(j.at("tokenId").get<std::string>());
+    }
 
-    };
+    void to_wire(WireWriter& w) const override {
+        w.writeArray(to);
+        writeWireUint256(w, token_id);
+    }
 
-    // Constructors for convenience
-    Erc20Result() : type(Erc20ResultType::EnumUnknown), value{} {}
+    void from_wire(WireReader& r) override {
+        r.readArray(to);
+        token_id = readWireUint256(r);
+    }
+};
 
-    // Getter for type
-    Erc20ResultType getType() const {
-        return type;
+class SetApprovalForAllInput : public Input {
+public:
+    Address operator_address{};
+    bool approved = false;
+
+    void to_json(json& j) const override {
+        j = json{{"operator", addressToString(operator_address)}, {"approved", approved}};
     }
 
-    // Setter for type
-    void setType(Erc20ResultType newType) {
-        type = newType;
+    void from_json(const json& j) override {
+        operator_address = convertStringToAddress(j.at("operator").get<std::string>());
+        j.at("approved").get_to(approved);
     }
 
-    // Getter for value
-    const Erc20ResultValue& getValue() const {
-        return value;
+    void to_wire(WireWriter& w) const override {
+        w.writeArray(operator_address);
+        w.writeU8(approved ? 1 : 0);
     }
 
-    Erc20Result &operator=(const Erc20Result &other)
-    {
-        // Handle copy assignment for value based on the type
-        switch (other.type) {
-        case Erc20ResultType::EnumName:
-            this->value.name = other.value.name;
-            break;
-        case Erc20ResultType::EnumSymbol:
-            this->value.symbol = other.value.symbol;
-            break;
-        case Erc20ResultType::EnumDecimals:
-            this->value.decimals = other.value.decimals;
-            break;
-        case Erc20ResultType::EnumTotalSupply:
-            this->value.totalSupply = other.value.totalSupply;
-            break;
-        case Erc20ResultType::EnumBalanceOf:
-            this->value.balance = other.value.balance;
-            break;
-        case Erc20ResultType::EnumTransfer:
-        case Erc20ResultType::EnumTransferFrom:
-            this->value.success = other.value.success;
-            break;
-        case Erc20ResultType::EnumApprove:
-            this->value.approve = other.value.approve;
-            break;
-        case Erc20ResultType::EnumAllowance:
-            this->value.remaining = other.value.remaining;
-            break;
-        default:
-            break;
-        }
-        return *this;
-    }
-
-    Erc20ResultType type;
-    Erc20ResultValue value;
+    void from_wire(WireReader& r) override {
+        r.readArray(operator_address);
+        approved = r.readU8() != 0;
+    }
 };
 
-class Erc721Result {
+class Erc721TransferFromInput : public Input {
+public:
+    Address from{};
+    Address to{};
+    uint256_t token_id;
+
+    void to_json(json& j) const override {
+        j = json{{"from", addressToString(from)}, {"to", addressToString(to)},
+                 {"tokenId", "0x" + uint256_to_hex(token_id)}};
+    }
+
+    void from_json(const json& j) override {
+        from = convertStringToAddress(j.at("from").get<std::string>());
+        to = convertStringToAddress(j.at("to").get<std::string>());
+        token_id = parseUint256(j.at("tokenId").get<std::string>());
+    }
+
+    void to_wire(WireWriter& w) const override {
+        w.writeArray(from);
+        w.writeArray(to);
+        writeWireUint256(w, token_id);
+    }
 
+    void from_wire(WireReader& r) override {
+        r.readArray(from);
+        r.readArray(to);
+        token_id = readWireUint256(r);
+    }
 };
 
-class ContractResult {
+class TokenByIndexInput : public Input {
 public:
-    using ResultType = std::variant<Erc20Result, Erc721Result>;
-
-    ContractResult() : result(std::in_place_type<Erc20Result>) {}
+    uint256_t index;
 
-    // Getter for result
-    const ResultType& getResult() const {
-        return result;
+    void to_json(json& j) const override {
+        j = json{{"index", "0x" + uint256_to_hex(index)}};
     }
 
-    void setType(Erc20Result::Erc20ResultType newType) {
-        std::get<Erc20Result>(result).type = newType;
+    void from_json(const json& j) override {
+        index = parseUint256(j.at("index").get<std::string>());
     }
 
-    // Setter for result
-    template <typename T>
-    void setResult(const T& newResult) {
-        result = newResult;
+    void to_wire(WireWriter& w) const override {
+        writeWireUint256(w, index);
     }
 
-    ResultType result;
+    void from_wire(WireReader& r) override {
+        index = readWireUint256(r);
+    }
 };
 
+class TokenOfOwnerByIndexInput : public Input {
+public:
+    Address owner{};
+    uint256_t index;
 
-class ContractOutputs {
-    const char* const contractOutputStr = "contractOutput";
+    void to_json(json& j) const override {
+        j = json{{"owner", addressToString(owner)}, {"index", "0x" + uint256_to_hex(index)}};
+    }
 
-public:
-    ContractResult result;
+    void from_json(const json& j) override {
+        owner = convertStringToAddress(j.at("owner").get<std::string>());
+        index = parseUint256(j.at("index").get<std::string>());
+    }
 
-    json to_json() const {
-        json j;
-        const auto& contract_result = result;
-        json result_json;
+    void to_wire(WireWriter& w) const override {
+        w.writeArray(owner);
+        writeWireUint256(w, index);
+    }
 
-        // Use std::visit to handle the variant type
+    void from_wire(WireReader& r) override {
+        r.readArray(owner);
+        index = readWireUint256(r);
+    }
+};
+
+class ERC721Inputs : public Input {
+public:
+    Erc721OwnerInput balance_of;
+    TokenIdInput owner_of;
+    TokenIdInput get_approved;
+    IsApprovedForAllInput is_approved_for_all;
+    Erc721ApproveInput approve;
+    SetApprovalForAllInput set_approval_for_all;
+    Erc721TransferFromInput transfer_from;
+    TokenByIndexInput token_by_index;
+    TokenOfOwnerByIndexInput token_of_owner_by_index;
+
+    // Only the inputs that were set are written
+    void to_json(json& j) const override {
+        j = json::object();
+        if (balance_of.owner != Address{}) balance_of.to_json(j["balanceOf"]);
+        if (owner_of.token_id != 0) owner_of.to_json(j["ownerOf"]);
+        if (get_approved.token_id != 0) get_approved.to_json(j["getApproved"]);
+        if (is_approved_for_all.owner != Address{}) is_approved_for_all.to_json(j["isApprovedForAll"]);
+        if (approve.token_id != 0) approve.to_json(j["approve"]);
+        if (set_approval_for_all.operator_address != Address{}) set_approval_for_all.to_json(j["setApprovalForAll"]);
+        if (transfer_from.to != Address{}) transfer_from.to_json(j["transferFrom"]);
+        if (token_by_index.index != 0) token_by_index.to_json(j["tokenByIndex"]);
+        if (token_of_owner_by_index.owner != Address{}) token_of_owner_by_index.to_json(j["tokenOfOwnerByIndex"]);
+    }
+
+    void from_json(const json& j) override {
+        if (j.find("balanceOf") != j.end()) balance_of.from_json(j.at("balanceOf"));
+        if (j.find("ownerOf") != j.end()) owner_of.from_json(j.at("ownerOf"));
+        if (j.find("getApproved") != j.end()) get_approved.from_json(j.at("getApproved"));
+        if (j.find("isApprovedForAll") != j.end()) is_approved_for_all.from_json(j.at("isApprovedForAll"));
+        if (j.find("approve") != j.end()) approve.from_json(j.at("approve"));
+        if (j.find("setApprovalForAll") != j.end()) set_approval_for_all.from_json(j.at("setApprovalForAll"));
+        if (j.find("transferFrom") != j.end()) transfer_from.from_json(j.at("transferFrom"));
+        if (j.find("tokenByIndex") != j.end()) token_by_index.from_json(j.at("tokenByIndex"));
+        if (j.find("tokenOfOwnerByIndex") != j.end()) token_of_owner_by_index.from_json(j.at("tokenOfOwnerByIndex"));
+    }
+
+    // Fixed layout: every function's inputs are always present
+    void to_wire(WireWriter& w) const override {
+        balance_of.to_wire(w);
+        owner_of.to_wire(w);
+        get_approved.to_wire(w);
+        is_approved_for_all.to_wire(w);
+        approve.to_wire(w);
+        set_approval_for_all.to_wire(w);
+        transfer_from.to_wire(w);
+        token_by_index.to_wire(w);
+        token_of_owner_by_index.to_wire(w);
+    }
+
+    void from_wire(WireReader& r) override {
+        balance_of.from_wire(r);
+        owner_of.from_wire(r);
+        get_approved.from_wire(r);
+        is_approved_for_all.from_wire(r);
+        approve.from_wire(r);
+        set_approval_for_all.from_wire(r);
+        transfer_from.from_wire(r);
+        token_by_index.from_wire(r);
+        token_of_owner_by_index.from_wire(r);
+    }
+};
+
+class FunctionInputs : public Input {
+public:
+    ERC20Inputs erc20;
+    ERC721Inputs erc721;
+
+    // Custom serialization function for FunctionInputs
+    void to_json(json& j) const override {
+        json erc20Json;
+        erc20.to_json(erc20Json);
+        j["erc20"] = erc20Json;
+        json erc721Json;
+        erc721.to_json(erc721Json);
+        if (!erc721Json.empty()) j["erc721"] = erc721Json;
+    }
+
+    // Custom deserialization function for FunctionInputs
+    void from_json(const json& j) override {
+        if (j.find("erc20") != j.end()) {
+            erc20.from_json(j.at("erc20"));
+        }
+        if (j.find("erc721") != j.end()) erc721.from_json(j.at("erc721"));
+    }
+
+    void to_wire(WireWriter& w) const override {
+        erc20.to_wire(w);
+        erc721.to_wire(w);
+    }
+
+    void from_wire(WireReader& r) override {
+        erc20.from_wire(r);
+        erc721.from_wire(r);
+    }
+
+};
+
+class ContractInputs : public Input {
+public:
+    std::string contract_fn;
+    FunctionInputs function_inputs;
+
+    // Custom serialization function for ContractInput
+    void to_json(json& j) const override {
+        j["contractFn"] = contract_fn;
+
+        json functionInputsJson;
+        function_inputs.to_json(functionInputsJson);
+        j["functionInputs"] = functionInputsJson;
+    }
+
+    // Custom deserialization function for ContractInput
+    void from_json(const json& j) override {
+        j.at("contractFn").get_to(contract_fn);
+        function_inputs.from_json(j.at("functionInputs"));
+    }
+
+    void to_wire(WireWriter& w) const override {
+        w.writeString(contract_fn);
+        function_inputs.to_wire(w);
+    }
+
+    void from_wire(WireReader& r) override {
+        contract_fn = r.readString();
+        function_inputs.from_wire(r);
+    }
+
+};
+
+/*
+    Fixed-size record for every contract event, with the parties in from/to:
+      ERC20   Transfer(from, to, value), Approval(owner, spender, value)
+      ERC721  Transfer(from, to, tokenId), Approval(owner, approved, tokenId),
+              ApprovalForAll(owner, operator, approved) with approved as 0 or 1
+*/
+struct ContractEvent {
+    enum class Kind : uint8_t {
+        Transfer,
+        Approval,
+        TokenTransfer,
+        TokenApproval,
+        ApprovalForAll
+    };
+
+    Kind kind = Kind::Transfer;
+    Address from{};
+    Address to{};
+    uint256_t value;
+
+    void to_json(json& j) const {
+        switch (kind) {
+            case Kind::Transfer:
+            case Kind::TokenTransfer:
+                j["event"] = "Transfer";
+                j["from"] = addressToString(from);
+                j["to"] = addressToString(to);
+                break;
+            case Kind::Approval:
+                j["event"] = "Approval";
+                j["owner"] = addressToString(from);
+                j["spender"] = addressToString(to);
+                break;
+            case Kind::TokenApproval:
+                j["event"] = "Approval";
+                j["owner"] = addressToString(from);
+                j["approved"] = addressToString(to);
+                break;
+            case Kind::ApprovalForAll:
+                j["event"] = "ApprovalForAll";
+                j["owner"] = addressToString(from);
+                j["operator"] = addressToString(to);
+                j["approved"] = value != 0;
+                return;
+        }
+        const bool token = kind == Kind::TokenTransfer || kind == Kind::TokenApproval;
+        j[token ? "tokenId" : "value"] = "0x" + uint256_to_hex(value);
+    }
+
+    // Same document as to_json, with its keys in the same sorted order
+    void appendCompactJson(std::string& out) const {
+        switch (kind) {
+            case Kind::Transfer:
+            case Kind::TokenTransfer:
+                out += "{\"event\":\"Transfer\",\"from\":\"";
+                appendAddress(out, from);
+                out += "\",\"to\":\"";
+                appendAddress(out, to);
+                out += kind == Kind::Transfer ? "\",\"value\":\"0x" : "\",\"tokenId\":\"0x";
+                break;
+            case Kind::Approval:
+                out += "{\"event\":\"Approval\",\"owner\":\"";
+                appendAddress(out, from);
+                out += "\",\"spender\":\"";
+                appendAddress(out, to);
+                out += "\",\"value\":\"0x";
+                break;
+            case Kind::TokenApproval:
+                out += "{\"approved\":\"";
+                appendAddress(out, to);
+                out += "\",\"event\":\"Approval\",\"owner\":\"";
+                appendAddress(out, from);
+                out += "\",\"tokenId\":\"0x";
+                break;
+            case Kind::ApprovalForAll:
+                out += value != 0 ? "{\"approved\":true" : "{\"approved\":false";
+                out += ",\"event\":\"ApprovalForAll\",\"operator\":\"";
+                appendAddress(out, to);
+                out += "\",\"owner\":\"";
+                appendAddress(out, from);
+                out += "\"}";
+                return;
+        }
+        appendUint256Hex(out, value);
+        out += "\"}";
+    }
+
+    void to_wire(WireWriter& w) const {
+        w.writeU8(static_cast<uint8_t>(kind));
+        w.writeArray(from);
+        w.writeArray(to);
+        writeWireUint256(w, value);
+    }
+
+    // Bytes to_wire() writes per event
+    static constexpr std::size_t kWireSize = 1 + 2 * ADDRESS_SIZE + 32;
+
+    void from_wire(WireReader& r) {
+        const uint8_t tag = r.readU8();
+        if (tag > static_cast<uint8_t>(Kind::ApprovalForAll)) throw std::runtime_error("Unknown event kind");
+        kind = static_cast<Kind>(tag);
+        r.readArray(from);
+        r.readArray(to);
+        value = readWireUint256(r);
+    }
+
+private:
+    static void appendAddress(std::string& out, const Address& address) {
+        char text[ADDRESS_HEX_LENGTH];
+        addressToHex(address, text);
+        out.append(text, ADDRESS_HEX_LENGTH);
+    }
+};
+
+/*
+    Per-call event arena.
+
+    Records are fixed-size and stored contiguously. clear() keeps the
+    capacity, so a buffer reused across calls only allocates when a call
+    emits more events than any call before it; appending an event is a
+    store into already reserved memory.
+*/
+class ContractEventBuffer {
+public:
+    static constexpr std::size_t kDefaultCapacity = 256;
+
+    explicit ContractEventBuffer(std::size_t capacity = kDefaultCapacity) {
+        events_.reserve(capacity);
+    }
+
+    void append(ContractEvent::Kind kind, const Address& from, const Address& to, const uint256_t& value) {
+        events_.push_back({kind, from, to, value});
+    }
+
+    bool empty() const { return events_.empty(); }
+    std::size_t size() const { return events_.size(); }
+    std::size_t capacity() const { return events_.capacity(); }
+    void clear() { events_.clear(); }
+    void truncate(std::size_t size) { events_.resize(std::min(size, events_.size())); }
+    void swap(ContractEventBuffer& other) { events_.swap(other.events_); }
+
+    auto begin() const { return events_.begin(); }
+    auto end() const { return events_.end(); }
+
+    void to_json(json& j) const {
+        j = json::array();
+        for (const auto& event : events_) {
+            json eventJson;
+            event.to_json(eventJson);
+            j.push_back(eventJson);
+        }
+    }
+
+    void appendCompactJson(std::string& out) const {
+        out += '[';
+        for (std::size_t i = 0; i < events_.size(); ++i) {
+            if (i) out += ',';
+            events_[i].appendCompactJson(out);
+        }
+        out += ']';
+    }
+
+    void to_wire(WireWriter& w) const {
+        w.writeU32(static_cast<uint32_t>(events_.size()));
+        for (const auto& event : events_) event.to_wire(w);
+    }
+
+    void from_wire(WireReader& r) {
+        events_.resize(r.readCount(ContractEvent::kWireSize));
+        for (auto& event : events_) event.from_wire(r);
+    }
+
+private:
+    std::vector<ContractEvent> events_;
+};
+
+// One ledger slot written by a call, with its value before and after
+struct Erc20StateChange {
+    enum class Slot : uint8_t {
+        Balance,      // balance of `account`
+        Allowance,    // allowance granted by `account` to `spender`
+        TotalSupply
+    };
+
+    Slot slot = Slot::Balance;
+    Address account{};
+    Address spender{};
+    uint256_t before;
+    uint256_t after;
+
+    static const char* slotName(Slot slot) {
+        switch (slot) {
+            case Slot::Balance: return "balance";
+            case Slot::Allowance: return "allowance";
+            case Slot::TotalSupply: return "totalSupply";
+        }
+        return "unknown";
+    }
+
+    // Orders entries by slot, then account, then spender
+    bool keyLess(const Erc20StateChange& other) const {
+        if (slot != other.slot) return slot < other.slot;
+        int order = std::memcmp(account.data(), other.account.data(), ADDRESS_SIZE);
+        if (order != 0) return order < 0;
+        return std::memcmp(spender.data(), other.spender.data(), ADDRESS_SIZE) < 0;
+    }
+
+    bool sameSlot(const Erc20StateChange& other) const {
+        return slot == other.slot && account == other.account && spender == other.spender;
+    }
+
+    void to_json(json& j) const {
+        j["slot"] = slotName(slot);
+        if (slot != Slot::TotalSupply) j["account"] = addressToString(account);
+        if (slot == Slot::Allowance) j["spender"] = addressToString(spender);
+        j["before"] = "0x" + uint256_to_hex(before);
+        j["after"] = "0x" + uint256_to_hex(after);
+    }
+
+    // Same document as to_json, keys in the order json::dump() sorts them
+    void appendCompactJson(std::string& out) const {
+        char address[ADDRESS_HEX_LENGTH];
+        out += '{';
+        if (slot != Slot::TotalSupply) {
+            addressToHex(account, address);
+            out += "\"account\":\"";
+            out.append(address, ADDRESS_HEX_LENGTH);
+            out += "\",";
+        }
+        out += "\"after\":\"0x";
+        appendUint256Hex(out, after);
+        out += "\",\"before\":\"0x";
+        appendUint256Hex(out, before);
+        out += "\",\"slot\":\"";
+        out += slotName(slot);
+        out += '"';
+        if (slot == Slot::Allowance) {
+            addressToHex(spender, address);
+            out += ",\"spender\":\"";
+            out.append(address, ADDRESS_HEX_LENGTH);
+            out += '"';
+        }
+        out += '}';
+    }
+
+    void to_wire(WireWriter& w) const {
+        w.writeU8(static_cast<uint8_t>(slot));
+        w.writeArray(account);
+        w.writeArray(spender);
+        writeWireUint256(w, before);
+        writeWireUint256(w, after);
+    }
+
+    // Bytes to_wire() writes per change
+    static constexpr std::size_t kWireSize = 1 + 2 * ADDRESS_SIZE + 2 * 32;
+
+    void from_wire(WireReader& r) {
+        slot = static_cast<Slot>(r.readU8());
+        r.readArray(account);
+        r.readArray(spender);
+        before = readWireUint256(r);
+        after = readWireUint256(r);
+    }
+};
+
+// Ordered log of ledger writes. Rolling back replays it in reverse;
+// coalesced() reduces it to one entry per slot for emission.
+class Erc20ChangeSet {
+public:
+    using Slot = Erc20StateChange::Slot;
+
+    void record(Slot slot, const Address& account, const Address& spender, const uint256_t& before,
+                const uint256_t& after) {
+        if (before != after) changes_.push_back({slot, account, spender, before, after});
+    }
+
+    bool empty() const { return changes_.empty(); }
+    std::size_t size() const { return changes_.size(); }
+    void clear() { changes_.clear(); }
+    void truncate(std::size_t size) { changes_.resize(std::min(size, changes_.size())); }
+
+    auto begin() const { return changes_.begin(); }
+    auto end() const { return changes_.end(); }
+    auto rbegin() const { return changes_.rbegin(); }
+    auto rend() const { return changes_.rend(); }
+
+    // One entry per touched slot, keeping its first `before` and last `after`;
+    // slots that ended where they started are dropped
+    Erc20ChangeSet coalesced() const {
+        std::vector<Erc20StateChange> sorted = changes_;
+        std::stable_sort(sorted.begin(), sorted.end(),
+                         [](const Erc20StateChange& a, const Erc20StateChange& b) { return a.keyLess(b); });
+        Erc20ChangeSet result;
+        for (std::size_t i = 0; i < sorted.size();) {
+            std::size_t last = i;
+            while (last + 1 < sorted.size() && sorted[last + 1].sameSlot(sorted[i])) ++last;
+            Erc20StateChange change = sorted[i];
+            change.after = sorted[last].after;
+            if (change.before != change.after) result.changes_.push_back(change);
+            i = last + 1;
+        }
+        return result;
+    }
+
+    void to_json(json& j) const {
+        j = json::array();
+        for (const auto& change : changes_) {
+            json changeJson;
+            change.to_json(changeJson);
+            j.push_back(changeJson);
+        }
+    }
+
+    void appendCompactJson(std::string& out) const {
+        out += '[';
+        for (std::size_t i = 0; i < changes_.size(); ++i) {
+            if (i) out += ',';
+            changes_[i].appendCompactJson(out);
+        }
+        out += ']';
+    }
+
+    void to_wire(WireWriter& w) const {
+        w.writeU32(static_cast<uint32_t>(changes_.size()));
+        for (const auto& change : changes_) change.to_wire(w);
+    }
+
+    void from_wire(WireReader& r) {
+        changes_.resize(r.readCount(Erc20StateChange::kWireSize));
+        for (auto& change : changes_) change.from_wire(r);
+    }
+
+private:
+    std::vector<Erc20StateChange> changes_;
+};
+
+#include <variant>
+
+// Longest name or symbol an Erc20Result carries; matches the snapshot header's name field
+constexpr std::size_t ERC20_RESULT_TEXT_CAPACITY = 64;
+
+/*
+    Result of one ERC20 call: a type tag plus one inline value.
+
+    Names and symbols live in a fixed buffer and amounts as native Uint256
+    limbs, so every alternative is trivially copyable. Results copy with
+    memcpy, need no destructor and never allocate. Read a value only
+    through the accessor that matches getType().
+*/
+class Erc20Result {
+public:
+    enum class Erc20ResultType : uint8_t {
+        EnumName,
+        EnumSymbol,
+        EnumDecimals,
+        EnumTotalSupply,
+        EnumBalanceOf,
+        EnumTransfer,
+        EnumTransferFrom,
+        EnumApprove,
+        EnumAllowance,
+        EnumTransferBatch,
+        EnumUnknown
+    };
+
+    Erc20Result() = default;
+
+    // Getter for type
+    Erc20ResultType getType() const {
+        return type_;
+    }
+
+    // Setter for type; the value keeps whatever it held
+    void setType(Erc20ResultType newType) {
+        type_ = newType;
+    }
+
+    // EnumName / EnumSymbol; throws std::length_error past ERC20_RESULT_TEXT_CAPACITY
+    void setText(Erc20ResultType newType, std::string_view text) {
+        if (text.size() > ERC20_RESULT_TEXT_CAPACITY) throw std::length_error("ERC20 result text is too long");
+        std::memcpy(value_.text, text.data(), text.size());
+        textSize_ = static_cast<uint8_t>(text.size());
+        type_ = newType;
+    }
+
+    void setDecimals(uint8_t decimals) {
+        value_.decimals = decimals;
+        type_ = Erc20ResultType::EnumDecimals;
+    }
+
+    // EnumTotalSupply / EnumBalanceOf / EnumAllowance
+    void setAmount(Erc20ResultType newType, const uint256_t& amount) {
+        value_.amount = toNativeUint256(amount);
+        type_ = newType;
+    }
+
+    // EnumTransfer / EnumTransferFrom / EnumApprove / EnumTransferBatch
+    void setSuccess(Erc20ResultType newType, bool success) {
+        value_.success = success;
+        type_ = newType;
+    }
+
+    std::string_view text() const {
+        return std::string_view(value_.text, textSize_);
+    }
+
+    uint8_t decimals() const {
+        return value_.decimals;
+    }
+
+    uint256_t amount() const {
+        return fromNativeUint256(value_.amount);
+    }
+
+    bool success() const {
+        return value_.success;
+    }
+
+private:
+    union Value {
+        char text[ERC20_RESULT_TEXT_CAPACITY];
+        uint8_t decimals;
+        Uint256 amount;
+        bool success;
+
+        Value() : text{} {}
+    };
+
+    Erc20ResultType type_ = Erc20ResultType::EnumUnknown;
+    uint8_t textSize_ = 0;
+    Value value_;
+};
+
+static_assert(std::is_trivially_copyable_v<Erc20Result>, "Erc20Result must stay trivially copyable");
+
+/*
+    Result of one ERC721 call, laid out like Erc20Result: a type tag plus an
+    inline value that is text, an amount or token id, an address, or a flag.
+    Unlike Erc20Result it serializes itself, so ContractOutputs only adds
+    the surrounding record.
+*/
+class Erc721Result {
+public:
+    enum class Erc721ResultType : uint8_t {
+        EnumName,
+        EnumSymbol,
+        EnumBalanceOf,
+        EnumOwnerOf,
+        EnumGetApproved,
+        EnumIsApprovedForAll,
+        EnumTotalSupply,
+        EnumTokenByIndex,
+        EnumTokenOfOwnerByIndex,
+        EnumApprove,
+        EnumSetApprovalForAll,
+        EnumTransferFrom,
+        EnumUnknown
+    };
+
+    enum class ValueKind : uint8_t {
+        None,
+        Text,
+        Amount,
+        Address,
+        Flag
+    };
+
+    Erc721Result() = default;
+
+    Erc721ResultType getType() const {
+        return type_;
+    }
+
+    void setType(Erc721ResultType newType) {
+        type_ = newType;
+    }
+
+    // What getType() carries: Amount covers balances, supply and token ids
+    static ValueKind kindOf(Erc721ResultType type) {
+        switch (type) {
+            case Erc721ResultType::EnumName:
+            case Erc721ResultType::EnumSymbol: return ValueKind::Text;
+            case Erc721ResultType::EnumBalanceOf:
+            case Erc721ResultType::EnumTotalSupply:
+            case Erc721ResultType::EnumTokenByIndex:
+            case Erc721ResultType::EnumTokenOfOwnerByIndex: return ValueKind::Amount;
+            case Erc721ResultType::EnumOwnerOf:
+            case Erc721ResultType::EnumGetApproved: return ValueKind::Address;
+            case Erc721ResultType::EnumIsApprovedForAll:
+            case Erc721ResultType::EnumApprove:
+            case Erc721ResultType::EnumSetApprovalForAll:
+            case Erc721ResultType::EnumTransferFrom: return ValueKind::Flag;
+            default: return ValueKind::None;
+        }
+    }
+
+    static const char* typeName(Erc721ResultType type) {
+        switch (type) {
+            case Erc721ResultType::EnumName: return "EnumName";
+            case Erc721ResultType::EnumSymbol: return "EnumSymbol";
+            case Erc721ResultType::EnumBalanceOf: return "EnumBalanceOf";
+            case Erc721ResultType::EnumOwnerOf: return "EnumOwnerOf";
+            case Erc721ResultType::EnumGetApproved: return "EnumGetApproved";
+            case Erc721ResultType::EnumIsApprovedForAll: return "EnumIsApprovedForAll";
+            case Erc721ResultType::EnumTotalSupply: return "EnumTotalSupply";
+            case Erc721ResultType::EnumTokenByIndex: return "EnumTokenByIndex";
+            case Erc721ResultType::EnumTokenOfOwnerByIndex: return "EnumTokenOfOwnerByIndex";
+            case Erc721ResultType::EnumApprove: return "EnumApprove";
+            case Erc721ResultType::EnumSetApprovalForAll: return "EnumSetApprovalForAll";
+            case Erc721ResultType::EnumTransferFrom: return "EnumTransferFrom";
+            default: return "Unknown";
+        }
+    }
+
+    // EnumName / EnumSymbol; throws std::length_error past ERC20_RESULT_TEXT_CAPACITY
+    void setText(Erc721ResultType newType, std::string_view text) {
+        if (text.size() > ERC20_RESULT_TEXT_CAPACITY) throw std::length_error("ERC721 result text is too long");
+        std::memcpy(value_.text, text.data(), text.size());
+        textSize_ = static_cast<uint8_t>(text.size());
+        type_ = newType;
+    }
+
+    void setAmount(Erc721ResultType newType, const uint256_t& amount) {
+        value_.amount = toNativeUint256(amount);
+        type_ = newType;
+    }
+
+    void setAddress(Erc721ResultType newType, const Address& address) {
+        value_.address = address;
+        type_ = newType;
+    }
+
+    void setFlag(Erc721ResultType newType, bool flag) {
+        value_.flag = flag;
+        type_ = newType;
+    }
+
+    std::string_view text() const {
+        return std::string_view(value_.text, textSize_);
+    }
+
+    uint256_t amount() const {
+        return fromNativeUint256(value_.amount);
+    }
+
+    const Address& address() const {
+        return value_.address;
+    }
+
+    bool flag() const {
+        return value_.flag;
+    }
+
+    // Flags are "1"/"0" strings and amounts decimal strings, as in ERC20 results
+    void to_json(json& j) const {
+        j["type"] = typeName(type_);
+        switch (kindOf(type_)) {
+            case ValueKind::Text: j["value"] = std::string(text()); break;
+            case ValueKind::Amount: j["value"] = amount().str(); break;
+            case ValueKind::Address: j["value"] = addressToString(address()); break;
+            case ValueKind::Flag: j["value"] = flag() ? "1" : "0"; break;
+            case ValueKind::None: j["value"] = "N/A"; break;
+        }
+    }
+
+    // The members of to_json's object, without the braces
+    void appendCompactJson(std::string& out) const {
+        out += "\"type\":\"";
+        out += typeName(type_);
+        out += "\",\"value\":";
+        switch (kindOf(type_)) {
+            case ValueKind::Text: out += json(text()).dump(); break;
+            case ValueKind::Amount:
+                out += '"';
+                out += amount().str();
+                out += '"';
+                break;
+            case ValueKind::Address: {
+                char hex[ADDRESS_HEX_LENGTH];
+                addressToHex(address(), hex);
+                out += '"';
+                out.append(hex, ADDRESS_HEX_LENGTH);
+                out += '"';
+                break;
+            }
+            case ValueKind::Flag: out += flag() ? "\"1\"" : "\"0\""; break;
+            case ValueKind::None: out += "\"N/A\""; break;
+        }
+    }
+
+    void to_wire(WireWriter& w) const {
+        w.writeU8(static_cast<uint8_t>(type_));
+        switch (kindOf(type_)) {
+            case ValueKind::Text: w.writeString(text()); break;
+            case ValueKind::Amount: w.writeUint256(value_.amount); break;
+            case ValueKind::Address: w.writeArray(value_.address); break;
+            case ValueKind::Flag: w.writeU8(value_.flag ? 1 : 0); break;
+            case ValueKind::None: break;
+        }
+    }
+
+    void from_wire(WireReader& r) {
+        const auto type = static_cast<Erc721ResultType>(r.readU8());
+        switch (kindOf(type)) {
+            case ValueKind::Text: setText(type, r.readString()); break;
+            case ValueKind::Amount: value_.amount = r.readUint256(); break;
+            case ValueKind::Address: r.readArray(value_.address); break;
+            case ValueKind::Flag: value_.flag = r.readU8() != 0; break;
+            case ValueKind::None: break;
+        }
+        type_ = type;
+    }
+
+private:
+    union Value {
+        char text[ERC20_RESULT_TEXT_CAPACITY];
+        Uint256 amount;
+        Address address;
+        bool flag;
+
+        Value() : text{} {}
+    };
+
+    Erc721ResultType type_ = Erc721ResultType::EnumUnknown;
+    uint8_t textSize_ = 0;
+    Value value_;
+};
+
+static_assert(std::is_trivially_copyable_v<Erc721Result>, "Erc721Result must stay trivially copyable");
+
+class ContractResult {
+public:
+    using ResultType = std::variant<Erc20Result, Erc721Result>;
+
+    ContractResult() : result(std::in_place_type<Erc20Result>) {}
+
+    // Getter for result
+    const ResultType& getResult() const {
+        return result;
+    }
+
+    void setType(Erc20Result::Erc20ResultType newType) {
+        std::get<Erc20Result>(result).setType(newType);
+    }
+
+    // Setter for result
+    template <typename T>
+    void setResult(const T& newResult) {
+        result = newResult;
+    }
+
+    ResultType result;
+};
+
+
+class ContractOutputs {
+    const char* const contractOutputStr = "contractOutput";
+
+public:
+    ContractResult result;
+    WireFormat format = WireFormat::Json;
+    // Ledger slots the call changed; omitted from the output when empty
+    Erc20ChangeSet stateDelta;
+    // Why the call failed (its writes were rolled back); omitted when empty
+    std::string error;
+    // Events the call emitted, swapped in from the token's buffer; omitted when empty
+    ContractEventBuffer events{0};
+
+    json to_json() const {
+        json j;
+        const auto& contract_result = result;
+        json result_json;
+
+        // Use std::visit to handle the variant type
         std::visit([&result_json](const auto& resultType) {
             using ResultType = std::decay_t<decltype(resultType)>;
             if constexpr (std::is_same_v<ResultType, Erc20Result>) {
@@ -558,42 +1755,52 @@ public:
 
                     case Erc20Result::Erc20ResultType::EnumName:
                         result_json["type"] = "EnumName";
-                        result_json["value"] = resultType.value.name;
+                        result_json["value"] = std::string(resultType.text());
                         break;
 
                     case Erc20Result::Erc20ResultType::EnumSymbol:
                         result_json["type"] = "EnumSymbol";
-                        result_json["value"] = resultType.value.symbol;
+                        result_json["value"] = std::string(resultType.text());
                         break;
 
                     case Erc20Result::Erc20ResultType::EnumDecimals:
                         result_json["type"] = "EnumDecimals";
-                        result_json["value"] = resultType.value.decimals;
+                        result_json["value"] = resultType.decimals();
                         break;
 
                     case Erc20Result::Erc20ResultType::EnumTotalSupply:
                         result_json["type"] = "EnumTotalSupply";
-                        result_json["value"] = resultType.value.totalSupply.str();
+                        result_json["value"] = resultType.amount().str();
                         break;
 
                     case Erc20Result::Erc20ResultType::EnumBalanceOf:
                         result_json["type"] = "EnumBalanceOf";
-                        result_json["value"] = resultType.value.balance.str();
+                        result_json["value"] = resultType.amount().str();
                         break;
 
                     case Erc20Result::Erc20ResultType::EnumTransfer:
                         result_json["type"] = "EnumTransfer";
-                        result_json["value"] = std::to_string(resultType.value.success);
+                        result_json["value"] = std::to_string(resultType.success());
                         break;
 
                     case Erc20Result::Erc20ResultType::EnumTransferFrom:
                         result_json["type"] = "EnumTransferFrom";
-                        result_json["value"] = std::to_string(resultType.value.success);
+                        result_json["value"] = std::to_string(resultType.success());
                         break;
 
                     case Erc20Result::Erc20ResultType::EnumApprove:
                         result_json["type"] = "EnumApprove";
-                        result_json["value"] = std::to_string(resultType.value.success);
+                        result_json["value"] = std::to_string(resultType.success());
+                        break;
+
+                    case Erc20Result::Erc20ResultType::EnumAllowance:
+                        result_json["type"] = "EnumAllowance";
+                        result_json["value"] = resultType.amount().str();
+                        break;
+
+                    case Erc20Result::Erc20ResultType::EnumTransferBatch:
+                        result_json["type"] = "EnumTransferBatch";
+                        result_json["value"] = std::to_string(resultType.success());
                         break;
 
                     default:
@@ -603,18 +1810,200 @@ public:
                         break;
                 }
             } else if constexpr (std::is_same_v<ResultType, Erc721Result>) {
-                    // Handle Erc721Result
-                    result_json["type"] = "Erc721";
-                    // Access Erc721Result fields using result.erc721Result
+                resultType.to_json(result_json);
             }
         }, contract_result.getResult());
         j["results"].push_back(result_json);
+        if (!stateDelta.empty()) stateDelta.to_json(j["stateDelta"]);
+        if (!error.empty()) j["error"] = error;
+        if (!events.empty()) events.to_json(j["events"]);
 
         return j;
     }
 
+    // Binary layout: magic, format version, result count, then per result a
+    // kind byte (0 = Erc20, 1 = Erc721), the result type and its value,
+    // then the state delta, the error string and the events
+    std::string to_binary() const {
+        std::string out;
+        out.reserve(64 + events.size() * 73);
+        WireWriter w(out);
+        w.writeBytes(WIRE_OUTPUT_MAGIC, sizeof(WIRE_OUTPUT_MAGIC));
+        w.writeU8(WIRE_FORMAT_VERSION);
+        w.writeU32(1);
+
+        std::visit([&w](const auto& resultType) {
+            using ResultType = std::decay_t<decltype(resultType)>;
+            if constexpr (std::is_same_v<ResultType, Erc20Result>) {
+                w.writeU8(0);
+                w.writeU8(static_cast<uint8_t>(resultType.getType()));
+                switch (resultType.getType()) {
+                    case Erc20Result::Erc20ResultType::EnumName:
+                    case Erc20Result::Erc20ResultType::EnumSymbol: w.writeString(resultType.text()); break;
+                    case Erc20Result::Erc20ResultType::EnumDecimals: w.writeU8(resultType.decimals()); break;
+                    case Erc20Result::Erc20ResultType::EnumTotalSupply:
+                    case Erc20Result::Erc20ResultType::EnumBalanceOf:
+                    case Erc20Result::Erc20ResultType::EnumAllowance: writeWireUint256(w, resultType.amount()); break;
+                    case Erc20Result::Erc20ResultType::EnumTransfer:
+                    case Erc20Result::Erc20ResultType::EnumTransferFrom:
+                    case Erc20Result::Erc20ResultType::EnumApprove:
+                    case Erc20Result::Erc20ResultType::EnumTransferBatch: w.writeU8(resultType.success() ? 1 : 0); break;
+                    default: break;
+                }
+            } else if constexpr (std::is_same_v<ResultType, Erc721Result>) {
+                w.writeU8(1);
+                resultType.to_wire(w);
+            }
+        }, result.getResult());
+        stateDelta.to_wire(w);
+        w.writeString(error);
+        events.to_wire(w);
+        return out;
+    }
+
+    void from_binary(std::string_view data) {
+        WireReader r(data);
+        r.expectMagic(WIRE_OUTPUT_MAGIC);
+        if (r.readU32() != 1) throw std::runtime_error("Expected exactly one contract result");
+
+        if (r.readU8() == 1) {
+            Erc721Result erc721;
+            erc721.from_wire(r);
+            result.setResult(erc721);
+        } else {
+            readErc20Result(r);
+        }
+        stateDelta.from_wire(r);
+        error = r.readString();
+        events.from_wire(r);
+        format = WireFormat::Binary;
+    }
+
+    void readErc20Result(WireReader& r) {
+        Erc20Result erc20;
+        using Type = Erc20Result::Erc20ResultType;
+        const auto type = static_cast<Type>(r.readU8());
+        switch (type) {
+            case Type::EnumName:
+            case Type::EnumSymbol: erc20.setText(type, r.readString()); break;
+            case Type::EnumDecimals: erc20.setDecimals(r.readU8()); break;
+            case Type::EnumTotalSupply:
+            case Type::EnumBalanceOf:
+            case Type::EnumAllowance: erc20.setAmount(type, readWireUint256(r)); break;
+            case Type::EnumTransfer:
+            case Type::EnumTransferFrom:
+            case Type::EnumApprove:
+            case Type::EnumTransferBatch: erc20.setSuccess(type, r.readU8() != 0); break;
+            default: erc20.setType(type); break;
+        }
+        result.setResult(erc20);
+    }
+
+    // Appends the same document as to_json().dump(), without building it first
+    void appendCompactJson(std::string& out) const {
+        out += '{';
+        if (!error.empty()) {
+            out += "\"error\":";
+            out += json(error).dump();
+            out += ',';
+        }
+        if (!events.empty()) {
+            out += "\"events\":";
+            events.appendCompactJson(out);
+            out += ',';
+        }
+        out += "\"results\":[{";
+        std::visit([&out](const auto& resultType) {
+            using ResultType = std::decay_t<decltype(resultType)>;
+            if constexpr (std::is_same_v<ResultType, Erc20Result>) {
+                auto typeAndString = [&out](const char* type, std::string_view text) {
+                    out += "\"type\":\"";
+                    out += type;
+                    out += "\",\"value\":";
+                    out += json(text).dump();
+                };
+                auto typeAndSuccess = [&out](const char* type, bool success) {
+                    out += "\"type\":\"";
+                    out += type;
+                    out += success ? "\",\"value\":\"1\"" : "\",\"value\":\"0\"";
+                };
+                switch (resultType.getType()) {
+                    case Erc20Result::Erc20ResultType::EnumName: typeAndString("EnumName", resultType.text()); break;
+                    case Erc20Result::Erc20ResultType::EnumSymbol: typeAndString("EnumSymbol", resultType.text()); break;
+                    case Erc20Result::Erc20ResultType::EnumDecimals:
+                        out += "\"type\":\"EnumDecimals\",\"value\":";
+                        out += std::to_string(resultType.decimals());
+                        break;
+                    case Erc20Result::Erc20ResultType::EnumTotalSupply:
+                        typeAndString("EnumTotalSupply", resultType.amount().str());
+                        break;
+                    case Erc20Result::Erc20ResultType::EnumBalanceOf:
+                        typeAndString("EnumBalanceOf", resultType.amount().str());
+                        break;
+                    case Erc20Result::Erc20ResultType::EnumTransfer: typeAndSuccess("EnumTransfer", resultType.success()); break;
+                    case Erc20Result::Erc20ResultType::EnumTransferFrom:
+                        typeAndSuccess("EnumTransferFrom", resultType.success());
+                        break;
+                    case Erc20Result::Erc20ResultType::EnumApprove: typeAndSuccess("EnumApprove", resultType.success()); break;
+                    case Erc20Result::Erc20ResultType::EnumAllowance:
+                        typeAndString("EnumAllowance", resultType.amount().str());
+                        break;
+                    case Erc20Result::Erc20ResultType::EnumTransferBatch:
+                        typeAndSuccess("EnumTransferBatch", resultType.success());
+                        break;
+                    default:
+                        out += "\"type\":\"Unknown\",\"value\":\"N/A\"";
+                        break;
+                }
+            } else if constexpr (std::is_same_v<ResultType, Erc721Result>) {
+                resultType.appendCompactJson(out);
+            }
+        }, result.getResult());
+        out += "}]";
+        if (!stateDelta.empty()) {
+            out += ",\"stateDelta\":";
+            stateDelta.appendCompactJson(out);
+        }
+        out += '}';
+    }
+
+    // Appends this result as one batch record: a compact JSON line, or a
+    // u32 length-prefixed binary message
+    void appendRecord(std::string& out) const {
+        VERSATUS_STATS_PHASE(Commit);
+        [[maybe_unused]] const size_t before = out.size();
+        if (format == WireFormat::Binary) {
+            std::string message = to_binary();
+            WireWriter w(out);
+            w.writeU32(static_cast<uint32_t>(message.size()));
+            w.writeBytes(message.data(), message.size());
+        } else {
+            appendCompactJson(out);
+            out += '\n';
+        }
+        VERSATUS_STATS_COUNT(BytesEmitted, out.size() - before);
+    }
+
     void commit() const {
-        cout << contractOutputStr << " :" << to_json().dump(CUSTOM_INDENT_SPACES) << std::endl;
+        VERSATUS_STATS_PHASE(Commit);
+        if (format == WireFormat::Binary) {
+            std::string out = to_binary();
+            writeOutput(out.data(), out.size());
+            VERSATUS_STATS_COUNT(BytesEmitted, out.size());
+            return;
+        }
+        if (debugOutput()) {
+            const std::string text = to_json().dump(CUSTOM_INDENT_SPACES);
+            cout << contractOutputStr << " :" << text << std::endl;
+            VERSATUS_STATS_COUNT(BytesEmitted, std::strlen(contractOutputStr) + 3 + text.size());
+            return;
+        }
+        std::string out;
+        out.reserve(256 + events.size() * 192);
+        appendCompactJson(out);
+        out += '\n';
+        writeOutput(out.data(), out.size());
+        VERSATUS_STATS_COUNT(BytesEmitted, out.size());
     }
 };
 
@@ -623,9 +2012,9 @@ class ProtocolInputs : public Input {
     const char* const blockHeightStr = "blockHeight";
     const char* const blockTimeStr = "blockTime";
 public:
-    int32_t version;
-    uint64_t block_height;
-    uint64_t block_time;
+    int32_t version = 0;
+    uint64_t block_height = 0;
+    uint64_t block_time = 0;
 
     // Custom serialization function for ProtocolInputs
     void to_json(json& j) const override {
@@ -639,6 +2028,18 @@ public:
         if (j.find(blockTimeStr) != j.end()) j.at(blockTimeStr).get_to(block_time);
     }
 
+    void to_wire(WireWriter& w) const override {
+        w.writeI32(version);
+        w.writeU64(block_height);
+        w.writeU64(block_time);
+    }
+
+    void from_wire(WireReader& r) override {
+        version = r.readI32();
+        block_height = r.readU64();
+        block_time = r.readU64();
+    }
+
 };
 
 class AccountInfo {
@@ -646,16 +2047,14 @@ class AccountInfo {
     const char* const accountBalanceStr = "accountBalance";
 
 public:
-    Address account_address;
+    Address account_address{};
     uint256_t account_balance;
 
     // Custom serialization function for AccountInfo
     void to_json(json& j) const {
         j[accountAddressStr] = addressToString(account_address);
         // Convert uint256_t to a string in hexadecimal format
-        std::ostringstream oss;
-        oss << std::hex << "0x" << account_balance;
-        j[accountBalanceStr] = oss.str();
+        j[accountBalanceStr] = "0x" + uint256_to_hex(account_balance);
     }
 
     // Custom deserialization function for AccountInfo
@@ -664,7 +2063,17 @@ public:
         account_address = convertStringToAddress(account_address_str);
 
         std::string account_balance_str = j.at(accountBalanceStr);
-        account_balance = boost::multiprecision::uint256_t(account_balance_str);
+        account_balance = uint256_t(account_balance_str);
+    }
+
+    void to_wire(WireWriter& w) const {
+        w.writeArray(account_address);
+        writeWireUint256(w, account_balance);
+    }
+
+    void from_wire(WireReader& r) {
+        r.readArray(account_address);
+        account_balance = readWireUint256(r);
     }
 
     std::string print_json() const {
@@ -677,47 +2086,559 @@ public:
 class ComputeInputs {
 
 public:
-    int32_t version;
+    int32_t version = 0;
     AccountInfo account_info;
     ProtocolInputs protocol_input;
     ApplicationInputs application_input;
     ContractInputs contract_input;
+    bool has_application_input = false;
+    bool has_contract_input = false;
+    // Encoding the inputs arrived in; outputs are committed in the same one
+    WireFormat format = WireFormat::Json;
+
+    void to_json(json& j) const {
+        j["version"] = version;
+        account_info.to_json(j["accountInfo"]);
+        protocol_input.to_json(j["protocolInput"]);
+        if (has_application_input) application_input.to_json(j["applicationInput"]);
+        if (has_contract_input) contract_input.to_json(j["contractInput"]);
+    }
 
-    static ComputeInputs gather() {
+    // Builds inputs from an already-parsed JSON document
+    void from_json(const json& json_obj) {
         const char* const versionStr = "version";
         const char* const applicationInputStr = "applicationInput";
         const char* const accountInfoStr = "accountInfo";
         const char* const protocolInputStr = "protocolInput";
         const char* const contractInputStr = "contractInput";
 
-        json json_obj;
-        cin >> json_obj;
-        ComputeInputs inputs;
-        
-        inputs.version = json_obj[versionStr];
+        json_obj.at(versionStr).get_to(version);
 
         if (json_obj.contains(accountInfoStr)) {
-            inputs.account_info.from_json(json_obj[accountInfoStr]);
+            account_info.from_json(json_obj[accountInfoStr]);
         }
 
         if (json_obj.contains(protocolInputStr)) {
-            inputs.protocol_input.from_json(json_obj[protocolInputStr]);
+            protocol_input.from_json(json_obj[protocolInputStr]);
+        }
+
+        has_application_input = json_obj.contains(applicationInputStr);
+        if (has_application_input) {
+            application_input.from_json(json_obj[applicationInputStr]);
         }
 
-        if (json_obj.contains(applicationInputStr)) {
-            inputs.application_input.from_json(json_obj[applicationInputStr]);
-            cout << "Object " << applicationInputStr << " :" << print_json(inputs.application_input) << std::endl;
+        has_contract_input = json_obj.contains(contractInputStr);
+        if (has_contract_input) {
+            contract_input.from_json(json_obj[contractInputStr]);
+        }
+    }
+
+    // Binary layout: magic, format version, version, account info, protocol
+    // input, a presence byte, then the application and contract inputs present
+    std::string to_binary() const {
+        std::string out;
+        WireWriter w(out);
+        w.writeBytes(WIRE_INPUT_MAGIC, sizeof(WIRE_INPUT_MAGIC));
+        w.writeU8(WIRE_FORMAT_VERSION);
+        w.writeI32(version);
+        account_info.to_wire(w);
+        protocol_input.to_wire(w);
+        w.writeU8(static_cast<uint8_t>((has_application_input ? 1 : 0) | (has_contract_input ? 2 : 0)));
+        if (has_application_input) application_input.to_wire(w);
+        if (has_contract_input) contract_input.to_wire(w);
+        return out;
+    }
+
+    static ComputeInputs from_binary(std::string_view data) {
+        ComputeInputs inputs;
+        WireReader r(data);
+        r.expectMagic(WIRE_INPUT_MAGIC);
+        inputs.version = r.readI32();
+        inputs.account_info.from_wire(r);
+        inputs.protocol_input.from_wire(r);
+        uint8_t present = r.readU8();
+        inputs.has_application_input = (present & 1) != 0;
+        inputs.has_contract_input = (present & 2) != 0;
+        if (inputs.has_application_input) inputs.application_input.from_wire(r);
+        if (inputs.has_contract_input) inputs.contract_input.from_wire(r);
+        inputs.format = WireFormat::Binary;
+        return inputs;
+    }
+
+    // Streams JSON text straight into the fields without building a DOM
+    static ComputeInputs parse(std::string_view text);
+
+    // Reads one call from stdin, as JSON or as a binary message with the input
+    // magic header. format is set before decoding, so a caller whose message
+    // fails to decode can still answer in the format it was sent in.
+    static ComputeInputs gather(WireFormat& format) {
+        VERSATUS_STATS_PHASE(Gather);
+        std::string text{std::istreambuf_iterator<char>(cin), std::istreambuf_iterator<char>()};
+        VERSATUS_STATS_COUNT(BytesParsed, text.size());
+        format = hasWireMagic(text, WIRE_INPUT_MAGIC) ? WireFormat::Binary : WireFormat::Json;
+        if (format == WireFormat::Binary) return from_binary(text);
+        ComputeInputs inputs = parse(text);
+        if (!debugOutput()) return inputs;
+
+        if (inputs.has_application_input) {
+            cout << "Object applicationInput :" << print_json(inputs.application_input) << std::endl;
         }
-        
-        if (json_obj.contains(contractInputStr)) {
-            inputs.contract_input.from_json(json_obj[contractInputStr]);
-            cout << contractInputStr << " :" << print_json(inputs.contract_input) << std::endl;
+
+        if (inputs.has_contract_input) {
+            cout << "contractInput :" << print_json(inputs.contract_input) << std::endl;
         }
 
         return inputs;
     }
 };
 
+/*
+    SAX handler behind ComputeInputs::parse.
+
+    Keeps a stack of the objects being decoded and writes each scalar
+    directly into its ComputeInputs field as the parser reports it.
+    Addresses and uint256 values are decoded from the lexer's buffer in
+    place, unknown keys are skipped, and the fields the DOM path reads with
+    at() are still required.
+*/
+class ComputeInputsSaxHandler {
+public:
+    explicit ComputeInputsSaxHandler(ComputeInputs& inputs) : inputs_(inputs) {}
+
+    const std::string& error() const {
+        return error_;
+    }
+
+    bool null() {
+        return skipping() || unexpected("null");
+    }
+
+    bool boolean(bool value) {
+        if (skipping()) return true;
+        if (!stack_.empty() && top().scope == Scope::SetApprovalForAll && key_ == Key::Approved) {
+            return assign(inputs_.contract_input.function_inputs.erc721.set_approval_for_all.approved, value);
+        }
+        return unexpected("boolean");
+    }
+
+    bool number_integer(json::number_integer_t value) {
+        if (skipping()) return true;
+        if (stack_.empty()) return fail("expected an object");
+        if (value < 0) return fail("unexpected negative number");
+        return number(static_cast<uint64_t>(value));
+    }
+
+    bool number_unsigned(json::number_unsigned_t value) {
+        if (skipping()) return true;
+        if (stack_.empty()) return fail("expected an object");
+        return number(value);
+    }
+
+    bool number_float(json::number_float_t value, const json::string_t&) {
+        if (skipping()) return true;
+        if (stack_.empty()) return fail("expected an object");
+        // Only whole numbers that fit a uint64_t convert exactly; NaN fails every test
+        if (!(value >= 0.0)) return fail("unexpected negative number");
+        if (!(value < 18446744073709551616.0)) return fail("number out of range");
+        if (std::trunc(value) != value) return fail("unexpected fractional number");
+        return number(static_cast<uint64_t>(value));
+    }
+
+    bool string(json::string_t& value) {
+        if (skipping()) return true;
+        if (stack_.empty()) return fail("expected an object");
+        Frame& frame = top();
+        std::string_view text(value);
+
+        if (frame.scope == Scope::Recipients) {
+            inputs_.application_input.recipients.push_back(value);
+            return true;
+        }
+        if (frame.scope == Scope::Payment) {
+            auto& payment = inputs_.contract_input.function_inputs.erc20.transfer_batch.payments.back();
+            if (key_ == Key::Address) return address(text, payment.to);
+            if (key_ == Key::Value) return amount(text, payment.value);
+            return unexpected("string");
+        }
+
+        auto& erc20 = inputs_.contract_input.function_inputs.erc20;
+        switch (frame.scope) {
+            case Scope::AccountInfo:
+                if (key_ == Key::AccountAddress) return address(text, inputs_.account_info.account_address);
+                if (key_ == Key::AccountBalance) return amount(text, inputs_.account_info.account_balance);
+                break;
+            case Scope::ApplicationInput:
+                if (key_ == Key::ContractFn) return assign(inputs_.application_input.contract_fn, value);
+                break;
+            case Scope::ContractInput:
+                if (key_ == Key::ContractFn) return assign(inputs_.contract_input.contract_fn, value);
+                break;
+            case Scope::Name:
+                if (key_ == Key::Value) return assign(erc20.name.value, value);
+                break;
+            case Scope::Symbol:
+                if (key_ == Key::Value) return assign(erc20.symbol.value, value);
+                break;
+            case Scope::TotalSupply:
+                if (key_ == Key::Value) return amount(text, erc20.total_supply.value);
+                break;
+            case Scope::BalanceOf:
+                if (key_ == Key::Address) return address(text, erc20.balance_of.account);
+                break;
+            case Scope::Transfer:
+                if (key_ == Key::Address) return address(text, erc20.transfer.address);
+                if (key_ == Key::Value) return amount(text, erc20.transfer.value);
+                break;
+            case Scope::TransferFrom:
+                if (key_ == Key::From) return address(text, erc20.transfer_from.from);
+                if (key_ == Key::To) return address(text, erc20.transfer_from.to);
+                if (key_ == Key::Value) return amount(text, erc20.transfer_from.value);
+                break;
+            case Scope::Approve:
+                if (key_ == Key::Address) return address(text, erc20.approve.address);
+                if (key_ == Key::Value) return amount(text, erc20.approve.value);
+                break;
+            case Scope::Allowance:
+                if (key_ == Key::Owner) return address(text, erc20.allowance.owner);
+                if (key_ == Key::Spender) return address(text, erc20.allowance.spender);
+                break;
+            default:
+                return erc721String(text);
+        }
+        return unexpected("string");
+    }
+
+    bool binary(json::binary_t&) {
+        return skipping() || unexpected("binary");
+    }
+
+    bool start_object(std::size_t) {
+        if (skipping() || stack_.empty()) {
+            return push(stack_.empty() ? Scope::Root : Scope::Skip);
+        }
+        if (top().scope == Scope::TransferBatch) {
+            inputs_.contract_input.function_inputs.erc20.transfer_batch.payments.emplace_back();
+            stack_.push_back({Scope::Payment, 0});
+            return true;
+        }
+        return push(childScope(top().scope, key_));
+    }
+
+    bool key(json::string_t& name) {
+        if (skipping()) return true;
+        key_ = keyFor(name);
+        return true;
+    }
+
+    bool end_object() {
+        Frame frame = stack_.back();
+        stack_.pop_back();
+        if (frame.scope == Scope::Skip) return true;
+
+        uint64_t required = requiredKeys(frame.scope);
+        if ((frame.seen & required) != required) return fail("missing required field");
+
+        switch (frame.scope) {
+            case Scope::ApplicationInput: inputs_.has_application_input = true; break;
+            case Scope::ContractInput: inputs_.has_contract_input = true; break;
+            default: break;
+        }
+        return true;
+    }
+
+    bool start_array(std::size_t) {
+        if (stack_.empty()) return fail("expected an object");
+        if (!skipping() && top().scope == Scope::ApplicationInput && key_ == Key::Recipients) {
+            inputs_.application_input.recipients.clear();
+            markSeen();
+            return push(Scope::Recipients);
+        }
+        if (!skipping() && top().scope == Scope::Erc20 && key_ == Key::TransferBatch) {
+            inputs_.contract_input.function_inputs.erc20.transfer_batch.payments.clear();
+            markSeen();
+            return push(Scope::TransferBatch);
+        }
+        return push(Scope::Skip);
+    }
+
+    bool end_array() {
+        stack_.pop_back();
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& ex) {
+        return fail(ex.what());
+    }
+
+private:
+    enum class Scope : uint8_t {
+        Root, AccountInfo, ProtocolInput, ApplicationInput, Recipients, ContractInput, FunctionInputs, Erc20,
+        Name, Symbol, Decimals, TotalSupply, BalanceOf, Transfer, TransferFrom, Approve, Allowance,
+        TransferBatch, Payment, Erc721, Erc721BalanceOf, OwnerOf, GetApproved, IsApprovedForAll, Erc721Approve, SetApprovalForAll,
+        Erc721TransferFrom, TokenByIndex, TokenOfOwnerByIndex, Skip
+    };
+
+    enum class Key : uint8_t {
+        Version, AccountInfo, AccountAddress, AccountBalance, ProtocolInput, BlockHeight, BlockTime,
+        ApplicationInput, ContractInput, ContractFn, Amount, Recipients, FunctionInputs, Erc20,
+        Name, Symbol, Decimals, TotalSupply, BalanceOf, Transfer, TransferFrom, Approve, Allowance,
+        Value, Address, From, To, Owner, Spender, Erc721, OwnerOf, GetApproved, IsApprovedForAll,
+        SetApprovalForAll, TokenByIndex, TokenOfOwnerByIndex, TokenId, Operator, Approved, Index,
+        TransferBatch, Unknown
+    };
+
+    struct Frame {
+        Scope scope;
+        uint64_t seen;  // bit per Key assigned inside this object
+    };
+
+    static_assert(static_cast<unsigned>(Key::Unknown) <= 64, "Frame::seen has one bit per key");
+
+    static constexpr uint64_t bit(Key key) {
+        return uint64_t(1) << static_cast<uint32_t>(key);
+    }
+
+    static Key keyFor(std::string_view name) {
+        static const std::pair<std::string_view, Key> keys[] = {
+            {"version", Key::Version}, {"accountInfo", Key::AccountInfo},
+            {"accountAddress", Key::AccountAddress}, {"accountBalance", Key::AccountBalance},
+            {"protocolInput", Key::ProtocolInput}, {"blockHeight", Key::BlockHeight},
+            {"blockTime", Key::BlockTime}, {"applicationInput", Key::ApplicationInput},
+            {"contractInput", Key::ContractInput}, {"contractFn", Key::ContractFn},
+            {"amount", Key::Amount}, {"recipients", Key::Recipients},
+            {"functionInputs", Key::FunctionInputs}, {"erc20", Key::Erc20},
+            {"name", Key::Name}, {"symbol", Key::Symbol}, {"decimals", Key::Decimals},
+            {"totalSupply", Key::TotalSupply}, {"balanceOf", Key::BalanceOf},
+            {"transfer", Key::Transfer}, {"transferFrom", Key::TransferFrom},
+            {"approve", Key::Approve}, {"allowance", Key::Allowance}, {"value", Key::Value},
+            {"address", Key::Address}, {"from", Key::From}, {"to", Key::To},
+            {"owner", Key::Owner}, {"spender", Key::Spender}, {"erc721", Key::Erc721},
+            {"ownerOf", Key::OwnerOf}, {"getApproved", Key::GetApproved},
+            {"isApprovedForAll", Key::IsApprovedForAll}, {"setApprovalForAll", Key::SetApprovalForAll},
+            {"tokenByIndex", Key::TokenByIndex}, {"tokenOfOwnerByIndex", Key::TokenOfOwnerByIndex},
+            {"tokenId", Key::TokenId}, {"operator", Key::Operator}, {"approved", Key::Approved},
+            {"index", Key::Index}, {"transferBatch", Key::TransferBatch},
+        };
+        for (const auto& entry : keys) {
+            if (entry.first == name) return entry.second;
+        }
+        return Key::Unknown;
+    }
+
+    // Which object a key opens inside its parent; anything else is skipped
+    static Scope childScope(Scope parent, Key key) {
+        switch (parent) {
+            case Scope::Root:
+                if (key == Key::AccountInfo) return Scope::AccountInfo;
+                if (key == Key::ProtocolInput) return Scope::ProtocolInput;
+                if (key == Key::ApplicationInput) return Scope::ApplicationInput;
+                if (key == Key::ContractInput) return Scope::ContractInput;
+                break;
+            case Scope::ContractInput:
+                if (key == Key::FunctionInputs) return Scope::FunctionInputs;
+                break;
+            case Scope::FunctionInputs:
+                if (key == Key::Erc20) return Scope::Erc20;
+                if (key == Key::Erc721) return Scope::Erc721;
+                break;
+            case Scope::Erc721:
+                switch (key) {
+                    case Key::BalanceOf: return Scope::Erc721BalanceOf;
+                    case Key::OwnerOf: return Scope::OwnerOf;
+                    case Key::GetApproved: return Scope::GetApproved;
+                    case Key::IsApprovedForAll: return Scope::IsApprovedForAll;
+                    case Key::Approve: return Scope::Erc721Approve;
+                    case Key::SetApprovalForAll: return Scope::SetApprovalForAll;
+                    case Key::TransferFrom: return Scope::Erc721TransferFrom;
+                    case Key::TokenByIndex: return Scope::TokenByIndex;
+                    case Key::TokenOfOwnerByIndex: return Scope::TokenOfOwnerByIndex;
+                    default: break;
+                }
+                break;
+            case Scope::Erc20:
+                switch (key) {
+                    case Key::Name: return Scope::Name;
+                    case Key::Symbol: return Scope::Symbol;
+                    case Key::Decimals: return Scope::Decimals;
+                    case Key::TotalSupply: return Scope::TotalSupply;
+                    case Key::BalanceOf: return Scope::BalanceOf;
+                    case Key::Transfer: return Scope::Transfer;
+                    case Key::TransferFrom: return Scope::TransferFrom;
+                    case Key::Approve: return Scope::Approve;
+                    case Key::Allowance: return Scope::Allowance;
+                    default: break;
+                }
+                break;
+            default:
+                break;
+        }
+        return Scope::Skip;
+    }
+
+    // Fields the DOM decoders fetch with at()
+    static uint64_t requiredKeys(Scope scope) {
+        switch (scope) {
+            case Scope::Root: return bit(Key::Version);
+            case Scope::AccountInfo: return bit(Key::AccountAddress) | bit(Key::AccountBalance);
+            case Scope::ApplicationInput: return bit(Key::ContractFn) | bit(Key::Amount) | bit(Key::Recipients);
+            case Scope::ContractInput: return bit(Key::ContractFn) | bit(Key::FunctionInputs);
+            case Scope::Name:
+            case Scope::Symbol:
+            case Scope::Decimals:
+            case Scope::TotalSupply: return bit(Key::Value);
+            case Scope::BalanceOf: return bit(Key::Address);
+            case Scope::Transfer:
+            case Scope::Approve:
+            case Scope::Payment: return bit(Key::Address) | bit(Key::Value);
+            case Scope::TransferFrom: return bit(Key::From) | bit(Key::To) | bit(Key::Value);
+            case Scope::Allowance: return bit(Key::Owner) | bit(Key::Spender);
+            case Scope::Erc721BalanceOf: return bit(Key::Owner);
+            case Scope::OwnerOf:
+            case Scope::GetApproved: return bit(Key::TokenId);
+            case Scope::IsApprovedForAll: return bit(Key::Owner) | bit(Key::Operator);
+            case Scope::Erc721Approve: return bit(Key::To) | bit(Key::TokenId);
+            case Scope::SetApprovalForAll: return bit(Key::Operator) | bit(Key::Approved);
+            case Scope::Erc721TransferFrom: return bit(Key::From) | bit(Key::To) | bit(Key::TokenId);
+            case Scope::TokenByIndex: return bit(Key::Index);
+            case Scope::TokenOfOwnerByIndex: return bit(Key::Owner) | bit(Key::Index);
+            default: return 0;
+        }
+    }
+
+    Frame& top() {
+        return stack_.back();
+    }
+
+    bool skipping() const {
+        return !stack_.empty() && stack_.back().scope == Scope::Skip;
+    }
+
+    bool push(Scope scope) {
+        if (!stack_.empty() && scope != Scope::Skip) markSeen();
+        stack_.push_back({scope, 0});
+        return true;
+    }
+
+    void markSeen() {
+        if (key_ != Key::Unknown) top().seen |= bit(key_);
+    }
+
+    bool fail(const std::string& message) {
+        error_ = message;
+        return false;
+    }
+
+    // Values under unknown keys are ignored, like the DOM decoders do
+    bool unexpected(const char* kind) {
+        if (stack_.empty()) return fail("expected an object");
+        if (key_ == Key::Unknown) return true;
+        return fail(std::string("unexpected ") + kind + " value");
+    }
+
+    template <typename T>
+    bool assign(T& field, const T& value) {
+        field = value;
+        markSeen();
+        return true;
+    }
+
+    bool erc721String(std::string_view text) {
+        auto& erc721 = inputs_.contract_input.function_inputs.erc721;
+        switch (top().scope) {
+            case Scope::Erc721BalanceOf:
+                if (key_ == Key::Owner) return address(text, erc721.balance_of.owner);
+                break;
+            case Scope::OwnerOf:
+                if (key_ == Key::TokenId) return amount(text, erc721.owner_of.token_id);
+                break;
+            case Scope::GetApproved:
+                if (key_ == Key::TokenId) return amount(text, erc721.get_approved.token_id);
+                break;
+            case Scope::IsApprovedForAll:
+                if (key_ == Key::Owner) return address(text, erc721.is_approved_for_all.owner);
+                if (key_ == Key::Operator) return address(text, erc721.is_approved_for_all.operator_address);
+                break;
+            case Scope::Erc721Approve:
+                if (key_ == Key::To) return address(text, erc721.approve.to);
+                if (key_ == Key::TokenId) return amount(text, erc721.approve.token_id);
+                break;
+            case Scope::SetApprovalForAll:
+                if (key_ == Key::Operator) return address(text, erc721.set_approval_for_all.operator_address);
+                break;
+            case Scope::Erc721TransferFrom:
+                if (key_ == Key::From) return address(text, erc721.transfer_from.from);
+                if (key_ == Key::To) return address(text, erc721.transfer_from.to);
+                if (key_ == Key::TokenId) return amount(text, erc721.transfer_from.token_id);
+                break;
+            case Scope::TokenByIndex:
+                if (key_ == Key::Index) return amount(text, erc721.token_by_index.index);
+                break;
+            case Scope::TokenOfOwnerByIndex:
+                if (key_ == Key::Owner) return address(text, erc721.token_of_owner_by_index.owner);
+                if (key_ == Key::Index) return amount(text, erc721.token_of_owner_by_index.index);
+                break;
+            default:
+                break;
+        }
+        return unexpected("string");
+    }
+
+    bool address(std::string_view text, Address& field) {
+        AddressParseError error = parseAddress(text, field);
+        if (error != AddressParseError::Ok) return fail(addressParseErrorMessage(error));
+        markSeen();
+        return true;
+    }
+
+    bool amount(std::string_view text, uint256_t& field) {
+        try {
+            field = parseUint256(text);
+        } catch (const std::exception& e) {
+            return fail(e.what());
+        }
+        markSeen();
+        return true;
+    }
+
+    bool number(uint64_t value) {
+        switch (top().scope) {
+            case Scope::Root:
+                if (key_ == Key::Version) return assign(inputs_.version, static_cast<int32_t>(value));
+                break;
+            case Scope::ProtocolInput:
+                if (key_ == Key::Version) return assign(inputs_.protocol_input.version, static_cast<int32_t>(value));
+                if (key_ == Key::BlockHeight) return assign(inputs_.protocol_input.block_height, value);
+                if (key_ == Key::BlockTime) return assign(inputs_.protocol_input.block_time, value);
+                break;
+            case Scope::ApplicationInput:
+                if (key_ == Key::Amount) return assign(inputs_.application_input.amount, value);
+                break;
+            case Scope::Decimals:
+                if (key_ == Key::Value) {
+                    return assign(inputs_.contract_input.function_inputs.erc20.decimals.value, static_cast<uint8_t>(value));
+                }
+                break;
+            default:
+                break;
+        }
+        return unexpected("number");
+    }
+
+    ComputeInputs& inputs_;
+    std::vector<Frame> stack_;
+    Key key_ = Key::Unknown;
+    std::string error_;
+};
+
+ComputeInputs ComputeInputs::parse(std::string_view text) {
+    ComputeInputs inputs;
+    ComputeInputsSaxHandler handler(inputs);
+    if (!json::sax_parse(text.begin(), text.end(), &handler)) {
+        throw std::runtime_error("ComputeInputs parse error: " + handler.error());
+    }
+    return inputs;
+}
+
 class ComputeTransaction {
 public:
     std::string recipient;
@@ -753,7 +2674,9 @@ public:
     }
 
     void commit() {
-        std::cout << toJSON() << std::endl;
+        std::string out = toJSON().dump();
+        out += '\n';
+        writeOutput(out.data(), out.size());
     }
 
 };
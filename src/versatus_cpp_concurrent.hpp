@@ -0,0 +1,138 @@
+#ifndef VERSATUS_CPP_CONCURRENT_HPP
+#define VERSATUS_CPP_CONCURRENT_HPP
+
+/*
+    An ERC20 that serves read-only queries from any number of threads while
+    one writer at a time executes calls (left-right).
+
+    Two copies of the token are kept. The writer executes a call on the
+    copy readers are not using, publishes it with one atomic store, waits
+    for the readers still on the old copy to leave, and replays the call's
+    change set onto the old copy so both are equal again. Readers never
+    block and never see a call half applied: each read runs against one
+    complete ledger version. The price is two copies of the ledger and a
+    writer that waits for in-flight reads, so reads should stay short.
+*/
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "./versatus_cpp_erc20.hpp"
+
+class ConcurrentErc20 {
+public:
+    // make() is called twice and must build the same token both times
+    template <typename MakeToken>
+    explicit ConcurrentErc20(MakeToken make) : tokens_{make(), make()} {}
+
+    ConcurrentErc20(const std::string& name, const std::string& symbol)
+        : ConcurrentErc20([&] { return ERC20(name, symbol); }) {}
+
+    ConcurrentErc20(const ConcurrentErc20&) = delete;
+    ConcurrentErc20& operator=(const ConcurrentErc20&) = delete;
+
+    // Runs fn(const ERC20&, uint64_t version) against the current ledger
+    // version, which stays fixed until fn returns. Lock-free for readers: a
+    // read only retries when a write is published while it is arriving.
+    template <typename Fn>
+    decltype(auto) read(Fn&& fn) const {
+        std::atomic<int64_t>* count;
+        int side;
+        for (;;) {
+            side = active_.load();
+            count = &readers_[side][_stripe()].value;
+            count->fetch_add(1);
+            // The writer may have flipped between the load and the arrival
+            if (active_.load() == side) break;
+            count->fetch_sub(1);
+        }
+        struct Leave {
+            std::atomic<int64_t>* count;
+            ~Leave() { count->fetch_sub(1, std::memory_order_release); }
+        } leave{count};
+        return fn(static_cast<const ERC20&>(tokens_[side]), versions_[side]);
+    }
+
+    uint256_t balanceOf(const Address &account) const {
+        return read([&](const ERC20& token, uint64_t) { return token.balanceOf(account); });
+    }
+
+    uint256_t allowance(const Address &owner, const Address &spender) const {
+        return read([&](const ERC20& token, uint64_t) { return token.allowance(owner, spender); });
+    }
+
+    uint256_t totalSupply() const {
+        return read([](const ERC20& token, uint64_t) { return token.totalSupply(); });
+    }
+
+    // Number of committed writes; every read sees one of these versions
+    uint64_t version() const {
+        return read([](const ERC20&, uint64_t version) { return version; });
+    }
+
+    // Executes one call like execute_erc20 and publishes its effects; a call
+    // that throws was rolled back and publishes nothing
+    void execute(const ContractInputs& contract_input, ContractOutputs& output) {
+        std::lock_guard<std::mutex> lock(writer_);
+        execute_erc20(tokens_[1 - active_.load(std::memory_order_relaxed)], contract_input, output);
+        _publish(output.stateDelta);
+    }
+
+    // Runs fn(ERC20&) as one write (e.g. minting) and publishes everything
+    // it changed. If fn throws, its writes are rolled back, nothing is
+    // published and the exception propagates.
+    template <typename Fn>
+    void write(Fn&& fn) {
+        std::lock_guard<std::mutex> lock(writer_);
+        ERC20& next = tokens_[1 - active_.load(std::memory_order_relaxed)];
+        const ERC20::Checkpoint checkpoint = next.checkpoint();
+        try {
+            fn(next);
+        } catch (...) {
+            next.rollbackTo(checkpoint);
+            throw;
+        }
+        next.clearEvents();
+        _publish(next.takeChanges());
+    }
+
+private:
+    static constexpr std::size_t kReaderStripes = 64;
+
+    // Reader arrivals are spread over cache lines so readers do not contend on one counter
+    struct alignas(64) ReaderCount {
+        std::atomic<int64_t> value{0};
+    };
+
+    static std::size_t _stripe() {
+        static std::atomic<std::size_t> nextStripe{0};
+        static thread_local const std::size_t stripe = nextStripe.fetch_add(1) % kReaderStripes;
+        return stripe;
+    }
+
+    // Makes the copy just written the one readers use, then brings the other up to date
+    void _publish(const Erc20ChangeSet& changes) {
+        const int old = active_.load(std::memory_order_relaxed);
+        versions_[1 - old] = versions_[old] + 1;
+        active_.store(1 - old);
+        // Store-then-load against the reader's fetch_add-then-load: only with
+        // every access seq_cst can the writer not miss a reader that has
+        // already validated the old side
+        for (const auto& count : readers_[old]) {
+            while (count.value.load(std::memory_order_seq_cst) != 0) std::this_thread::yield();
+        }
+        tokens_[old].applyChanges(changes);
+        versions_[old] = versions_[1 - old];
+    }
+
+    ERC20 tokens_[2];
+    uint64_t versions_[2] = {0, 0};
+    std::atomic<int> active_{0};
+    mutable ReaderCount readers_[2][kReaderStripes];
+    std::mutex writer_;
+};
+
+#endif  // VERSATUS_CPP_CONCURRENT_HPP
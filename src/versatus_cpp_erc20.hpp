@@ -1,31 +1,116 @@
 
+#ifndef VERSATUS_CPP_ERC20_HPP
+#define VERSATUS_CPP_ERC20_HPP
+
 /* 
     Based on OpenZeppelin 
     https://github.com/OpenZeppelin/openzeppelin-contracts/blob/master/contracts/token/ERC20/ERC20.sol
 */
 
+#include <span>
+
 #include "./versatus_cpp_ierc20.hpp"
+#include "./versatus_cpp_flat_map.hpp"
+#include "./versatus_cpp_snapshot.hpp"
 
-class ERC20 : public IERC20 {
+// Composite (owner, spender) key so an allowance is one flat table slot
+struct AllowanceKey {
+    Address owner;
+    Address spender;
 
-private:
-    struct AddressHash {
-        size_t operator()(const Address& addr) const {
-            // A simple hash function for std::array
-            size_t result = 0;
-            for (const auto& byte : addr) {
-                result = (result << 8) ^ byte;
-            }
-            return result;
-        }
-    };
+    bool operator==(const AllowanceKey& other) const {
+        return owner == other.owner && spender == other.spender;
+    }
+};
+
+// An allowance and its neighbours in the owner's ring of table entries, so
+// one owner's allowances are enumerated without a per-owner container
+struct AllowanceSlot {
+    uint256_t value;
+    Address prev;
+    Address next;
+};
 
+// Hashes the 40-byte key as five words with the same mixing and seed as AddressHash
+struct AllowanceKeyHash {
+    size_t operator()(const AllowanceKey& key) const {
+        static_assert(sizeof(AllowanceKey) == 2 * ADDRESS_SIZE, "AllowanceKey must be packed");
+        uint64_t w[5];
+        std::memcpy(w, &key, sizeof(w));
+        uint64_t h = AddressHash::hashWords(w[0], w[1], w[2]);
+        return static_cast<size_t>(AddressHash::hashWords(h ^ w[3], w[4], h));
+    }
+};
+
+// Outcome of a token ledger operation. Failures are reported, never thrown,
+// so rejected calls stay on the fast path.
+enum class Erc20Status : uint8_t {
+    Ok,
+    InvalidSender,
+    InvalidReceiver,
+    InsufficientBalance,
+    InsufficientAllowance,
+    SupplyOverflow
+};
+
+const char* erc20StatusMessage(Erc20Status status) {
+    switch (status) {
+        case Erc20Status::Ok: return "ERC20: ok";
+        case Erc20Status::InvalidSender: return "ERC20: ERC20InvalidSender";
+        case Erc20Status::InvalidReceiver: return "ERC20: ERC20InvalidReceiver";
+        case Erc20Status::InsufficientBalance: return "ERC20: transfer amount exceeds balance";
+        case Erc20Status::InsufficientAllowance: return "ERC20: transfer amount exceeds allowance";
+        case Erc20Status::SupplyOverflow: return "ERC20: total supply overflow";
+    }
+    return "ERC20: unknown status";
+}
+
+// Ledger slots a speculative view read from the token it was opened over
+struct Erc20ReadSet {
+    std::vector<Address> balances;
+    std::vector<AllowanceKey> allowances;
+    bool totalSupply = false;
+
+    void clear() {
+        balances.clear();
+        allowances.clear();
+        totalSupply = false;
+    }
+};
+
+class Erc20ParallelExecutor;
+
+class ERC20 {
+
+    // Reuses one speculative view across calls through _resetView()
+    friend class Erc20ParallelExecutor;
+
+private:
     std::string name_;
     std::string symbol_;
     uint8_t decimals_;
     uint256_t totalSupply_;
-    std::unordered_map <Address, uint256_t, AddressHash> balances_;
-    std::unordered_map <Address, std::unordered_map <Address, uint256_t, AddressHash>, AddressHash> allowances_;
+    Erc20Status status_ = Erc20Status::Ok;
+    FlatHashMap<Address, uint256_t, AddressHash> balances_;
+    FlatHashMap<AllowanceKey, AllowanceSlot, AllowanceKeyHash> allowances_;
+    // Owner -> a spender in that owner's ring of allowances_ entries
+    FlatHashMap<Address, Address, AddressHash> firstSpender_;
+    // Mapped base state. When present, the maps above only hold entries
+    // changed since it was written, including zeros that shadow its records.
+    Erc20Snapshot snapshot_;
+    std::size_t holders_ = 0;
+    std::size_t allowanceEntries_ = 0;
+    // Every ledger write since the change set was last taken or rolled back
+    Erc20ChangeSet changes_;
+    // Events of the current call; mutable because Erc20Token emits from const methods
+    mutable ContractEventBuffer events_;
+    // Scratch for transferBatch/mintBatch, kept so repeated batches do not allocate
+    std::vector<Erc20Payment> batch_;
+    FlatHashMap<Address, std::size_t, AddressHash> batchIndex_;
+    // Set on a speculative view: reads that miss the maps above go to base_
+    // instead of the snapshot, and are logged in reads_
+    const ERC20* base_ = nullptr;
+    Erc20ReadSet* reads_ = nullptr;
 
 public:
 
@@ -33,100 +118,252 @@ public:
         : name_(name), symbol_(symbol), decimals_(18), totalSupply_(0) {
     }
 
+    // Starts from a mapped snapshot; nothing is copied out of it up front
+    explicit ERC20(Erc20Snapshot snapshot) : snapshot_(std::move(snapshot)) {
+        const SnapshotHeader& header = snapshot_.header();
+        name_.assign(header.name, header.nameLength);
+        symbol_.assign(header.symbol, header.symbolLength);
+        decimals_ = header.decimals;
+        totalSupply_ = fromNativeUint256(header.totalSupply);
+        holders_ = header.holderCount;
+        allowanceEntries_ = header.allowanceEntryCount;
+    }
 
-    virtual void TransferEvent(const Address &from, const Address &to, uint256_t value) const override {
-        // TO DO
+
+    void TransferEvent(const Address &from, const Address &to, uint256_t value) const {
+        events_.append(ContractEvent::Kind::Transfer, from, to, value);
     }
     
-    virtual void ApprovalEvent(const Address &owner, const Address &spender, uint256_t value) const override {
-        // TO DO
+    void ApprovalEvent(const Address &owner, const Address &spender, uint256_t value) const {
+        events_.append(ContractEvent::Kind::Approval, owner, spender, value);
+    }
+
+    // Events emitted since the buffer was last cleared
+    const ContractEventBuffer& events() const {
+        return events_;
+    }
+
+    void clearEvents() {
+        events_.clear();
+    }
+
+    // Exchanges event buffers so a call's events move out without copying and
+    // a drained buffer (with its capacity) can be handed back for reuse
+    void swapEvents(ContractEventBuffer& other) {
+        events_.swap(other);
     }
 
     // ERC20 Token Metadata
-    virtual std::string name() const override {
+    std::string name() const {
         return name_;
     }
 
-    virtual std::string symbol() const override {
+    std::string symbol() const {
         return symbol_;
     }
 
-    virtual uint8_t decimals() const override {
+    uint8_t decimals() const {
         return decimals_;
     }
 
     // ERC20 Token Supply
-    virtual uint256_t totalSupply() const override {
+    uint256_t totalSupply() const {
+        _readSupply();
         return totalSupply_;
     }
     
     // ERC20 balanceOf
-    virtual uint256_t balanceOf(const Address &account) const override {
-        auto it = balances_.find(account);
-        return (it != balances_.end()) ? it->second : 0;
+    uint256_t balanceOf(const Address &account) const {
+        return _balanceOf(account);
     }
 
     // ERC20 Token Transfer
-    virtual bool transfer(const Address &to, uint256_t value) override {
+    bool transfer(const Address &to, uint256_t value) {
         auto owner = _msgSender();
-        _transfer(owner, to, value);
-        return true;
+        return _record(_transfer(owner, to, value));
     }
 
     // ERC20 Token Allowance
-    virtual uint256_t allowance(const Address &owner, const Address &spender) const override {
-        auto itOuter = allowances_.find(owner);
-        if (itOuter != allowances_.end()) {
-            auto itInner = itOuter->second.find(spender);
-            if (itInner != itOuter->second.end()) {
-                return itInner->second;
-            }
+    uint256_t allowance(const Address &owner, const Address &spender) const {
+        return _allowance({owner, spender});
+    }
+
+    // Number of non-zero balances / allowances
+    std::size_t holderCount() const {
+        return holders_;
+    }
+
+    std::size_t allowanceCount() const {
+        return allowanceEntries_;
+    }
+
+    // Why the last state-changing call failed (Ok if it succeeded)
+    Erc20Status lastStatus() const {
+        return status_;
+    }
+
+    // Visits every (spender, allowance) pair granted by owner, in time
+    // proportional to that owner's allowances
+    template <typename Fn>
+    void forEachAllowance(const Address &owner, Fn&& fn) const {
+        auto first = firstSpender_.find(owner);
+        if (first != firstSpender_.end()) {
+            Address spender = first->second;
+            do {
+                const AllowanceSlot& slot = allowances_.find({owner, spender})->second;
+                if (slot.value != 0) fn(spender, slot.value);
+                spender = slot.next;
+            } while (spender != first->second);
+        }
+        // Snapshot records are sorted by owner, so its part is one contiguous range
+        for (const AllowanceRecord* record = snapshot_.lowerBoundAllowance(owner, Address{});
+             record != snapshot_.allowancesEnd() && record->owner == owner; ++record) {
+            if (record->value.isZero() || allowances_.contains({record->owner, record->spender})) continue;
+            fn(record->spender, uint256_t(fromNativeUint256(record->value)));
+        }
+    }
+
+    // Writes made since the change set was last taken or rolled back, in order
+    const Erc20ChangeSet& changes() const {
+        return changes_;
+    }
+
+    // Hands the pending writes to the caller (to emit or journal) and starts a new change set
+    Erc20ChangeSet takeChanges() {
+        return std::exchange(changes_, Erc20ChangeSet{});
+    }
+
+    // Positions in the pending change set and event buffer that rollbackTo() can return to
+    struct Checkpoint {
+        std::size_t changes;
+        std::size_t events;
+    };
+
+    Checkpoint checkpoint() const {
+        return {changes_.size(), events_.size()};
+    }
+
+    // Undoes, newest first, every write made since checkpoint and drops the events emitted since
+    void rollbackTo(const Checkpoint& checkpoint) {
+        events_.truncate(checkpoint.events);
+        if (checkpoint.changes >= changes_.size()) return;
+        std::vector<Erc20StateChange> undo(changes_.begin() + checkpoint.changes, changes_.end());
+        for (auto it = undo.rbegin(); it != undo.rend(); ++it) _restore(*it, it->before);
+        // Drop the undone writes along with the writes that undid them
+        changes_.truncate(checkpoint.changes);
+    }
+
+    // Restores every slot in the pending change set to its value before the first write
+    void rollback() {
+        rollbackTo({0, 0});
+    }
+
+    // Replays changes (e.g. from a journal) by writing their `after` values;
+    // the replayed writes are not added to the pending change set
+    void applyChanges(const Erc20ChangeSet& changes) {
+        const std::size_t pending = changes_.size();
+        for (const auto& change : changes) _restore(change, change.after);
+        changes_.truncate(pending);
+    }
+
+    // Persists the ledger and continues from the written snapshot. Saving
+    // over the mapped snapshot patches the changed records in place when no
+    // key is new to it; otherwise a compacted file is written next to path
+    // and renamed over it. Throws std::runtime_error on I/O failure.
+    void saveSnapshot(const std::string& path) {
+        if (snapshot_ && snapshot_.path() == path && _patchSnapshot()) {
+            balances_.clear();
+            allowances_.clear();
+            firstSpender_.clear();
+            return;
         }
-        return 0;
+        _rewriteSnapshot(path);
+        balances_.clear();
+        allowances_.clear();
+        firstSpender_.clear();
+        snapshot_ = Erc20Snapshot::open(path);
+    }
+
+    // A token that executes calls on top of this one's current state
+    // without writing to it: its writes stay in its own maps, change set and
+    // events, and every slot it reads from this token is logged in reads.
+    // This token must not change while the view is in use.
+    ERC20 speculativeView(Erc20ReadSet& reads) const {
+        ERC20 view(name_, symbol_);
+        view.decimals_ = decimals_;
+        view.base_ = this;
+        view._resetView(reads);
+        return view;
     }
 
     // ERC20 Token Approval
-    bool approve(const Address &spender, uint256_t value) override {
+    bool approve(const Address &spender, uint256_t value) {
         auto owner = _msgSender();
-        allowances_[owner][spender] = value;
+        _setAllowance({owner, spender}, value);
         ApprovalEvent(owner, spender, value);
-        return true;
+        return _record(Erc20Status::Ok);
     }
 
     // ERC20 Token transferFrom
-    bool transferFrom(const Address &from, const Address &to, uint256_t value) override {
+    bool transferFrom(const Address &from, const Address &to, uint256_t value) {
         auto owner = _msgSender();
-        require(value <= balances_[from], "ERC20: transfer amount exceeds balance");
-        require(value <= allowances_[from][owner], "ERC20: transfer amount exceeds allowance");
-        balances_[from] -= value;
-        balances_[to] += value;
-        allowances_[from][owner] -= value;
-        return true;
+        if (value > _balanceOf(from)) [[unlikely]] return _record(Erc20Status::InsufficientBalance);
+        const uint256_t currentAllowance = _allowance({from, owner});
+        if (value > currentAllowance) [[unlikely]] return _record(Erc20Status::InsufficientAllowance);
+        // _transfer validates everything before writing, so the allowance is only spent on success
+        Erc20Status status = _transfer(from, to, value);
+        if (status == Erc20Status::Ok) _setAllowance({from, owner}, currentAllowance - value);
+        return _record(status);
     }
 
-    void mint(const Address &account, uint256_t value) {
-        if (account == Address{}) {
-            std::cerr << "ERC20: Invalid receiver" << std::endl;
-            std::terminate();
-        }
-        _update(Address{}, account, value);
+    // Pays every recipient from the sender. The sender's balance is checked
+    // and debited once for the total; repeated recipients are merged and
+    // credited (with one Transfer event each) in the order they first appear.
+    // Nothing is written unless every payment can be made.
+    bool transferBatch(std::span<const Erc20Payment> payments) {
+        auto owner = _msgSender();
+        return _record(_transferBatch(owner, payments));
     }
 
-    void burn(const Address &account, uint256_t value) {
-        if (account == Address{}) {
-            std::cerr << "ERC20: Invalid sender" << std::endl;
-            std::terminate();
-        }
-        _update(account, Address{}, value);
+    // mint() for many recipients, with the new total supply checked once
+    Erc20Status mintBatch(std::span<const Erc20Payment> payments) {
+        return _recordStatus(_mintBatch(payments));
+    }
+
+    Erc20Status mint(const Address &account, uint256_t value) {
+        if (account == Address{}) [[unlikely]] return _recordStatus(Erc20Status::InvalidReceiver);
+        return _recordStatus(_update(Address{}, account, value));
+    }
+
+    Erc20Status burn(const Address &account, uint256_t value) {
+        if (account == Address{}) [[unlikely]] return _recordStatus(Erc20Status::InvalidSender);
+        return _recordStatus(_update(account, Address{}, value));
     }
 
 private:
-    // Helper function to check conditions
-    void require(bool condition, const std::string& message) {
-        if (!condition) {
-            std::cerr << message << std::endl;
-            std::terminate();
-        }
+    // Drops a view's writes so its next call starts from the base state again
+    void _resetView(Erc20ReadSet& reads) {
+        assert(base_ && "_resetView() is only valid on a speculative view");
+        balances_.clearKeepCapacity();
+        allowances_.clearKeepCapacity();
+        firstSpender_.clearKeepCapacity();
+        changes_.clear();
+        events_.clear();
+        status_ = Erc20Status::Ok;
+        totalSupply_ = base_->totalSupply_;
+        holders_ = base_->holders_;
+        allowanceEntries_ = base_->allowanceEntries_;
+        reads_ = &reads;
+    }
+
+    bool _record(Erc20Status status) {
+        status_ = status;
+        return status == Erc20Status::Ok;
+    }
+
+    Erc20Status _recordStatus(Erc20Status status) {
+        status_ = status;
+        return status;
     }
     
     Address _msgSender() const {
@@ -137,146 +374,648 @@ private:
         return sender;
     }
 
-    bool isZeroAddress(const Address& address) {
+    // Read path: lookups never materialize entries; the snapshot answers for untouched keys
+    uint256_t _balanceOf(const Address& account) const {
+        VERSATUS_STATS_COUNT(MapLookups, 1);
+        auto it = balances_.find(account);
+        return (it != balances_.end()) ? it->second : _baseBalance(account);
+    }
+
+    uint256_t _allowance(const AllowanceKey& key) const {
+        VERSATUS_STATS_COUNT(MapLookups, 1);
+        auto it = allowances_.find(key);
+        return (it != allowances_.end()) ? it->second.value : _baseAllowance(key);
+    }
+
+    // What lies under the maps: the base token for a view, otherwise the snapshot
+    uint256_t _baseBalance(const Address& account) const {
+        if (!base_) return snapshot_.balanceOf(account);
+        reads_->balances.push_back(account);
+        return base_->_balanceOf(account);
+    }
+
+    uint256_t _baseAllowance(const AllowanceKey& key) const {
+        if (!base_) return snapshot_.allowance(key.owner, key.spender);
+        reads_->allowances.push_back(key);
+        return base_->_allowance(key);
+    }
+
+    // Whether a zero written to the maps must stay to shadow a value below them
+    bool _baseHasBalance(const Address& account) const {
+        return base_ || snapshot_.findBalance(account);
+    }
+
+    bool _baseHasAllowance(const AllowanceKey& key) const {
+        return base_ || snapshot_.findAllowance(key.owner, key.spender);
+    }
+
+    void _readSupply() const {
+        if (reads_) reads_->totalSupply = true;
+    }
+
+    void _restore(const Erc20StateChange& change, const uint256_t& value) {
+        switch (change.slot) {
+            case Erc20StateChange::Slot::Balance: _setBalance(change.account, value); break;
+            case Erc20StateChange::Slot::Allowance: _setAllowance({change.account, change.spender}, value); break;
+            case Erc20StateChange::Slot::TotalSupply: totalSupply_ = value; break;
+        }
+    }
+
+    static void _countChange(std::size_t& count, const uint256_t& before, const uint256_t& after) {
+        if (before == 0) {
+            if (after != 0) ++count;
+        } else if (after == 0) {
+            --count;
+        }
+    }
+
+    // Write path: zeros free their slot unless it has to shadow a snapshot record
+    void _setBalance(const Address& account, const uint256_t& value) {
+        VERSATUS_STATS_COUNT(MapLookups, 1);
+        auto it = balances_.find(account);
+        const uint256_t before = (it != balances_.end()) ? it->second : _baseBalance(account);
+        _countChange(holders_, before, value);
+        changes_.record(Erc20StateChange::Slot::Balance, account, Address{}, before, value);
+        if (value == 0 && !_baseHasBalance(account)) {
+            if (it != balances_.end()) balances_.erase(it);
+        } else if (it != balances_.end()) {
+            it->second = value;
+        } else {
+            VERSATUS_STATS_COUNT(MapInserts, 1);
+            balances_.try_emplace(account, value);
+        }
+    }
+
+    void _setAllowance(const AllowanceKey& key, const uint256_t& value) {
+        VERSATUS_STATS_COUNT(MapLookups, 1);
+        auto it = allowances_.find(key);
+        const uint256_t before = (it != allowances_.end()) ? it->second.value : _baseAllowance(key);
+        _countChange(allowanceEntries_, before, value);
+        changes_.record(Erc20StateChange::Slot::Allowance, key.owner, key.spender, before, value);
+        if (value == 0 && !_baseHasAllowance(key)) {
+            if (it != allowances_.end()) {
+                const Address prev = it->second.prev;
+                const Address next = it->second.next;
+                allowances_.erase(it);
+                _unlinkSpender(key, prev, next);
+            }
+        } else if (it != allowances_.end()) {
+            it->second.value = value;
+        } else {
+            VERSATUS_STATS_COUNT(MapInserts, 1);
+            allowances_.try_emplace(key, AllowanceSlot{value, key.spender, key.spender});
+            _linkSpender(key);
+        }
+    }
+
+    // Puts a new allowances_ entry last in its owner's ring; a lone entry links to itself
+    void _linkSpender(const AllowanceKey& key) {
+        auto [first, inserted] = firstSpender_.try_emplace(key.owner, key.spender);
+        if (inserted) return;
+        const Address head = first->second;
+        AllowanceSlot& headSlot = allowances_.find({key.owner, head})->second;
+        const Address tail = headSlot.prev;
+        headSlot.prev = key.spender;
+        allowances_.find({key.owner, tail})->second.next = key.spender;
+        AllowanceSlot& slot = allowances_.find(key)->second;
+        slot.prev = tail;
+        slot.next = head;
+    }
+
+    // Closes the ring over an erased entry that sat between prev and next
+    void _unlinkSpender(const AllowanceKey& key, const Address& prev, const Address& next) {
+        auto first = firstSpender_.find(key.owner);
+        if (next == key.spender) {
+            firstSpender_.erase(first);
+            return;
+        }
+        allowances_.find({key.owner, prev})->second.next = next;
+        allowances_.find({key.owner, next})->second.prev = prev;
+        if (first->second == key.spender) first->second = next;
+    }
+
+    void _credit(const Address& account, const uint256_t& value) {
+        if (value == 0) return;
+        auto [it, inserted] = balances_.try_emplace(account);
+        VERSATUS_STATS_COUNT(MapLookups, 1);
+        VERSATUS_STATS_COUNT(MapInserts, inserted);
+        if (inserted && (snapshot_ || base_)) it->second = _baseBalance(account);
+        if (it->second == 0) ++holders_;
+        const uint256_t before = it->second;
+        it->second += value;
+        changes_.record(Erc20StateChange::Slot::Balance, account, Address{}, before, it->second);
+    }
+
+    // In-place update of the mapped file through a patch file; false
+    // (nothing written) if any changed key is new to it
+    bool _patchSnapshot() {
+        for (const auto& entry : balances_) {
+            if (!snapshot_.findBalance(entry.first)) return false;
+        }
+        for (const auto& entry : allowances_) {
+            if (!snapshot_.findAllowance(entry.first.owner, entry.first.spender)) return false;
+        }
+
+        SnapshotPatch patch(Erc20Snapshot::fileSize(snapshot_.header().balanceCount,
+                                                     snapshot_.header().allowanceCount));
+        for (const auto& entry : balances_) {
+            const Uint256 value = toNativeUint256(entry.second);
+            patch.add(snapshot_.offsetOf(snapshot_.findBalance(entry.first)) + offsetof(BalanceRecord, value),
+                      &value, sizeof(value));
+        }
+        for (const auto& entry : allowances_) {
+            const Uint256 value = toNativeUint256(entry.second.value);
+            const AllowanceRecord* record = snapshot_.findAllowance(entry.first.owner, entry.first.spender);
+            patch.add(snapshot_.offsetOf(record) + offsetof(AllowanceRecord, value), &value, sizeof(value));
+        }
+        SnapshotHeader header = snapshot_.header();
+        header.totalSupply = toNativeUint256(totalSupply_);
+        header.holderCount = holders_;
+        header.allowanceEntryCount = allowanceEntries_;
+        patch.add(0, &header, sizeof(header));
+
+        // Records and header change together: the synced patch is replayed
+        // on the next open if the writes below are cut short
+        const std::string& path = snapshot_.path();
+        patch.commit(path);
+        int fd = ::open(path.c_str(), O_WRONLY);
+        if (fd < 0) throw std::runtime_error("Cannot open snapshot " + path);
+        try {
+            patch.apply(fd, path);
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+        ::close(fd);
+        const std::string patchPath = snapshotPatchPath(path);
+        if (::unlink(patchPath.c_str()) != 0) throw std::runtime_error("Cannot remove snapshot patch " + patchPath);
+        return true;
+    }
+
+    void _rewriteSnapshot(const std::string& path) {
+        if (name_.size() > SNAPSHOT_NAME_CAPACITY || symbol_.size() > SNAPSHOT_SYMBOL_CAPACITY) {
+            throw std::runtime_error("Token name or symbol is too long for a snapshot");
+        }
+
+        std::vector<BalanceRecord> balanceChanges;
+        balanceChanges.reserve(balances_.size());
+        for (const auto& entry : balances_) {
+            BalanceRecord record{};
+            record.account = entry.first;
+            record.value = toNativeUint256(entry.second);
+            balanceChanges.push_back(record);
+        }
+        std::vector<AllowanceRecord> allowanceChanges;
+        allowanceChanges.reserve(allowances_.size());
+        for (const auto& entry : allowances_) {
+            allowanceChanges.push_back({entry.first.owner, entry.first.spender, toNativeUint256(entry.second.value)});
+        }
+
+        auto balances = mergeSnapshotRecords(snapshot_.balancesBegin(), snapshot_.balancesEnd(),
+            std::move(balanceChanges), [](const BalanceRecord& a, const BalanceRecord& b) {
+                return compareAddresses(a.account, b.account) < 0;
+            });
+        auto allowances = mergeSnapshotRecords(snapshot_.allowancesBegin(), snapshot_.allowancesEnd(),
+            std::move(allowanceChanges), [](const AllowanceRecord& a, const AllowanceRecord& b) {
+                int order = compareAddresses(a.owner, b.owner);
+                return order != 0 ? order < 0 : compareAddresses(a.spender, b.spender) < 0;
+            });
+
+        SnapshotHeader header{};
+        std::memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+        header.version = SNAPSHOT_VERSION;
+        header.byteOrder = SNAPSHOT_BYTE_ORDER_MARK;
+        header.decimals = decimals_;
+        header.nameLength = static_cast<uint8_t>(name_.size());
+        header.symbolLength = static_cast<uint8_t>(symbol_.size());
+        std::memcpy(header.name, name_.data(), name_.size());
+        std::memcpy(header.symbol, symbol_.data(), symbol_.size());
+        header.totalSupply = toNativeUint256(totalSupply_);
+        header.balanceCount = header.holderCount = balances.size();
+        header.allowanceCount = header.allowanceEntryCount = allowances.size();
+
+        // Written beside path and renamed, so readers never see a partial file
+        const std::string tmpPath = path + ".tmp";
+        int fd = ::open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) throw std::runtime_error("Cannot create snapshot " + tmpPath);
+        try {
+            const off_t balancesOffset = sizeof(header);
+            const off_t allowancesOffset = balancesOffset + balances.size() * sizeof(BalanceRecord);
+            writeSnapshotAt(fd, &header, sizeof(header), 0);
+            writeSnapshotAt(fd, balances.data(), balances.size() * sizeof(BalanceRecord), balancesOffset);
+            writeSnapshotAt(fd, allowances.data(), allowances.size() * sizeof(AllowanceRecord), allowancesOffset);
+            // The data must be durable before the rename can expose it
+            syncSnapshotFile(fd, tmpPath);
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+        ::close(fd);
+        // A patch left for the file being replaced must not be replayed over the new one
+        const std::string patchPath = snapshotPatchPath(path);
+        if (::unlink(patchPath.c_str()) != 0 && errno != ENOENT) {
+            throw std::runtime_error("Cannot remove snapshot patch " + patchPath);
+        }
+        if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+            throw std::runtime_error("Cannot replace snapshot " + path);
+        }
+        syncSnapshotDirectory(path);
+    }
+
+    bool isZeroAddress(const Address& address) const {
         return (address == Address{});
     }
 
-    bool isNonZeroAddress(const Address& address) {
+    bool isNonZeroAddress(const Address& address) const {
         return !isZeroAddress(address);
     }
     
-    void _transfer(const Address &from, const Address &to, uint256_t value) {
-        require(isNonZeroAddress(from), "ERC20: ERC20InvalidSender");
-        require(isNonZeroAddress(to), "ERC20: ERC20InvalidReceiver");
-        _update(from, to, value);
+    Erc20Status _transfer(const Address &from, const Address &to, uint256_t value) {
+        if (isZeroAddress(from)) [[unlikely]] return Erc20Status::InvalidSender;
+        if (isZeroAddress(to)) [[unlikely]] return Erc20Status::InvalidReceiver;
+        return _update(from, to, value);
+    }
+
+    Erc20Status _transferBatch(const Address &from, std::span<const Erc20Payment> payments) {
+        if (isZeroAddress(from)) [[unlikely]] return Erc20Status::InvalidSender;
+        uint256_t total;
+        // No balance can cover a total that overflows
+        Erc20Status status = _batchTotal(payments, total, Erc20Status::InsufficientBalance);
+        if (status != Erc20Status::Ok) [[unlikely]] return status;
+        const uint256_t fromBalance = _balanceOf(from);
+        if (fromBalance < total) [[unlikely]] return Erc20Status::InsufficientBalance;
+
+        if (total != 0) _setBalance(from, fromBalance - total);
+        _prepareBatch(payments);
+        for (const auto& entry : batch_) {
+            _credit(entry.to, entry.value);
+            TransferEvent(from, entry.to, entry.value);
+        }
+        return Erc20Status::Ok;
+    }
+
+    Erc20Status _mintBatch(std::span<const Erc20Payment> payments) {
+        uint256_t total, newSupply;
+        Erc20Status status = _batchTotal(payments, total, Erc20Status::SupplyOverflow);
+        if (status != Erc20Status::Ok) [[unlikely]] return status;
+        _readSupply();
+        if (addOverflow(totalSupply_, total, newSupply)) [[unlikely]] return Erc20Status::SupplyOverflow;
+
+        changes_.record(Erc20StateChange::Slot::TotalSupply, Address{}, Address{}, totalSupply_, newSupply);
+        totalSupply_ = newSupply;
+        _prepareBatch(payments);
+        for (const auto& entry : batch_) {
+            _credit(entry.to, entry.value);
+            TransferEvent(Address{}, entry.to, entry.value);
+        }
+        return Erc20Status::Ok;
+    }
+
+    // Checks every recipient and sums the payments into total; touches no state
+    Erc20Status _batchTotal(std::span<const Erc20Payment> payments, uint256_t& total, Erc20Status overflow) const {
+        total = 0;
+        for (const auto& payment : payments) {
+            if (isZeroAddress(payment.to)) [[unlikely]] return Erc20Status::InvalidReceiver;
+            uint256_t sum;
+            if (addOverflow(total, payment.value, sum)) [[unlikely]] return overflow;
+            total = sum;
+        }
+        return Erc20Status::Ok;
     }
 
-    void _update(Address from, Address to, uint256_t value) {
+    // Fills batch_ with the payments ordered by the balance-table group their
+    // recipient hashes to, repeats merged. Runs only once the batch is known
+    // to succeed, so a rejected batch leaves the table as it was.
+    void _prepareBatch(std::span<const Erc20Payment> payments) {
+        batch_.clear();
+        if (payments.empty()) return;
+        // Growing up front means the credit pass never rehashes. Only
+        // recipients new to the table count, so crediting existing holders
+        // never inflates it.
+        if (payments.size() > balances_.growthLeft()) {
+            std::size_t newKeys = 0;
+            for (const auto& payment : payments) newKeys += balances_.contains(payment.to) ? 0 : 1;
+            balances_.reserve(balances_.size() + newKeys);
+        }
+
+        // Repeats are merged into the recipient's first payment, so credits,
+        // change records and events follow the input whatever the table's
+        // capacity or seed
+        batchIndex_.reserve(payments.size());
+        for (const auto& payment : payments) {
+            auto [it, inserted] = batchIndex_.try_emplace(payment.to, batch_.size());
+            // A merged value never exceeds the checked total, so it cannot overflow
+            if (inserted) batch_.push_back(payment);
+            else batch_[it->second].value += payment.value;
+        }
+        // Emptied key by key: clearing would walk the capacity left by the largest batch so far
+        for (const auto& entry : batch_) batchIndex_.erase(entry.to);
+    }
+
+    // Checks come before any write, so a failed update leaves state untouched
+    Erc20Status _update(Address from, Address to, uint256_t value) {
+        if (from == Address{} || to == Address{}) _readSupply();
         if (from == Address{}) {
-            // Overflow check required: The rest of the code assumes that totalSupply never overflows
-            totalSupply_ += value;
+            // Every balance is bounded by totalSupply, so this is the only add that can overflow
+            uint256_t newSupply;
+            if (addOverflow(totalSupply_, value, newSupply)) [[unlikely]] return Erc20Status::SupplyOverflow;
+            changes_.record(Erc20StateChange::Slot::TotalSupply, Address{}, Address{}, totalSupply_, newSupply);
+            totalSupply_ = newSupply;
         } else {
+            VERSATUS_STATS_COUNT(MapLookups, 1);
             auto itFrom = balances_.find(from);
-            if (itFrom == balances_.end()) {
-                // Handle insufficient balance error
-                std::cerr << "ERC20: Insufficient balance" << std::endl;
-                std::terminate();
-            }
-            if (itFrom->second < value) {
-                // Handle insufficient balance error
-                std::cerr << "ERC20: Insufficient balance" << std::endl;
-                std::terminate();
+            if (itFrom != balances_.end()) {
+                if (itFrom->second < value) [[unlikely]] return Erc20Status::InsufficientBalance;
+                // Overflow not possible: value <= fromBalance <= totalSupply.
+                if (value != 0) {
+                    changes_.record(Erc20StateChange::Slot::Balance, from, Address{}, itFrom->second,
+                                    itFrom->second - value);
+                    itFrom->second -= value;
+                    if (itFrom->second == 0) {
+                        --holders_;
+                        if (!_baseHasBalance(from)) balances_.erase(itFrom);
+                    }
+                }
+            } else {
+                // Only a snapshot or a view's base can hold a balance the overlay has not seen
+                const uint256_t fromBalance = _baseBalance(from);
+                if (fromBalance < value) [[unlikely]] return Erc20Status::InsufficientBalance;
+                if (value != 0) _setBalance(from, fromBalance - value);
             }
-            // Overflow not possible: value <= fromBalance <= totalSupply.
-            itFrom->second -= value;
         }
 
         if (to == Address{}) {
             // Overflow not possible: value <= totalSupply or value <= fromBalance <= totalSupply.
+            changes_.record(Erc20StateChange::Slot::TotalSupply, Address{}, Address{}, totalSupply_,
+                            totalSupply_ - value);
             totalSupply_ -= value;
         } else {
             // Overflow not possible: balance + value is at most totalSupply, which we know fits into a uint256.
-            balances_[to] += value;
+            _credit(to, value);
         }
 
         // Emit Transfer event
         TransferEvent(from, to, value);
+        return Erc20Status::Ok;
     }
 };
 
+static_assert(Erc20Token<ERC20>, "ERC20 must offer the IERC20 calls");
+
 
 enum Erc20ContractFunction {
+    ERC20_NAME,
+    ERC20_SYMBOL,
+    ERC20_DECIMALS,
+    ERC20_TOTALSUPPLY,
+    ERC20_BALANCEOF,
     ERC20_ALLOWANCE,
     ERC20_APPROVE,
     ERC20_TRANSFER,
     ERC20_TRANSFERFROM,
+    ERC20_TRANSFERBATCH,
     UNSUPPORTED_FUNCTION
 };
 
-Erc20ContractFunction getErc20ContractFunction(const std::string &function_name) {
-    if (function_name == "allowance") {
-        return Erc20ContractFunction::ERC20_ALLOWANCE;
-    }
-    if (function_name == "approve") {
-        return Erc20ContractFunction::ERC20_APPROVE;
-    }
-    if (function_name == "transfer") {
-        return Erc20ContractFunction::ERC20_TRANSFER;
-    }
-    if (function_name == "transferFrom") {
-        return Erc20ContractFunction::ERC20_TRANSFERFROM;
+// Executes one call against the token and fills in its result
+using Erc20Handler = void (*)(ERC20& token, const ERC20Inputs& inputs, Erc20Result& result);
+
+struct Erc20FunctionEntry {
+    std::string_view name;
+    Erc20ContractFunction function;
+    Erc20Handler handler;
+    // State-changing calls report success in result.success()
+    bool mutating;
+};
+
+using Erc20Type = Erc20Result::Erc20ResultType;
+
+inline constexpr Erc20FunctionEntry ERC20_FUNCTIONS[] = {
+    {"name", ERC20_NAME, [](ERC20& token, const ERC20Inputs&, Erc20Result& result) {
+        result.setText(Erc20Type::EnumName, token.name());
+    }, false},
+    {"symbol", ERC20_SYMBOL, [](ERC20& token, const ERC20Inputs&, Erc20Result& result) {
+        result.setText(Erc20Type::EnumSymbol, token.symbol());
+    }, false},
+    {"decimals", ERC20_DECIMALS, [](ERC20& token, const ERC20Inputs&, Erc20Result& result) {
+        result.setDecimals(token.decimals());
+    }, false},
+    {"totalSupply", ERC20_TOTALSUPPLY, [](ERC20& token, const ERC20Inputs&, Erc20Result& result) {
+        result.setAmount(Erc20Type::EnumTotalSupply, token.totalSupply());
+    }, false},
+    {"balanceOf", ERC20_BALANCEOF, [](ERC20& token, const ERC20Inputs& inputs, Erc20Result& result) {
+        result.setAmount(Erc20Type::EnumBalanceOf, token.balanceOf(inputs.balance_of.account));
+    }, false},
+    {"allowance", ERC20_ALLOWANCE, [](ERC20& token, const ERC20Inputs& inputs, Erc20Result& result) {
+        result.setAmount(Erc20Type::EnumAllowance, token.allowance(inputs.allowance.owner, inputs.allowance.spender));
+    }, false},
+    {"approve", ERC20_APPROVE, [](ERC20& token, const ERC20Inputs& inputs, Erc20Result& result) {
+        result.setSuccess(Erc20Type::EnumApprove, token.approve(inputs.approve.address, inputs.approve.value));
+    }, true},
+    {"transfer", ERC20_TRANSFER, [](ERC20& token, const ERC20Inputs& inputs, Erc20Result& result) {
+        result.setSuccess(Erc20Type::EnumTransfer, token.transfer(inputs.transfer.address, inputs.transfer.value));
+    }, true},
+    {"transferFrom", ERC20_TRANSFERFROM, [](ERC20& token, const ERC20Inputs& inputs, Erc20Result& result) {
+        result.setSuccess(Erc20Type::EnumTransferFrom, token.transferFrom(inputs.transfer_from.from,
+                                                                          inputs.transfer_from.to,
+                                                                          inputs.transfer_from.value));
+    }, true},
+    {"transferBatch", ERC20_TRANSFERBATCH, [](ERC20& token, const ERC20Inputs& inputs, Erc20Result& result) {
+        result.setSuccess(Erc20Type::EnumTransferBatch, token.transferBatch(inputs.transfer_batch.payments));
+    }, true},
+};
+
+/*
+    Perfect hash from function name to ERC20_FUNCTIONS index.
+
+    (length + first character) mod 32 is distinct for every name in the
+    table, so a lookup is one slot load and one string compare. The
+    static_assert fails the build if a new entry ever collides.
+*/
+namespace erc20_dispatch_detail {
+
+constexpr std::size_t kSlots = 32;
+
+constexpr std::size_t slotOf(std::string_view name) {
+    return (name.size() + static_cast<unsigned char>(name[0])) & (kSlots - 1);
+}
+
+constexpr std::array<int8_t, kSlots> makeSlots() {
+    std::array<int8_t, kSlots> slots{};
+    for (auto& slot : slots) slot = -1;
+    for (std::size_t i = 0; i < std::size(ERC20_FUNCTIONS); ++i) {
+        slots[slotOf(ERC20_FUNCTIONS[i].name)] = static_cast<int8_t>(i);
     }
-    return Erc20ContractFunction::UNSUPPORTED_FUNCTION;
+    return slots;
 }
 
+constexpr bool isPerfect() {
+    std::array<int8_t, kSlots> slots = makeSlots();
+    std::size_t used = 0;
+    for (int8_t slot : slots) used += (slot >= 0) ? 1 : 0;
+    return used == std::size(ERC20_FUNCTIONS);
+}
 
-void process_erc20(void) {
+inline constexpr std::array<int8_t, kSlots> kSlotTable = makeSlots();
+static_assert(isPerfect(), "ERC20 function names collide in the dispatch table");
 
-    ComputeInputs inputs = ComputeInputs::gather();
-    ContractInputs contract_input = inputs.contract_input;
+} // namespace erc20_dispatch_detail
 
-    Erc20ContractFunction function = getErc20ContractFunction(contract_input.contract_fn);
+// Table entry for function_name, or nullptr when it is not an ERC20 function
+inline const Erc20FunctionEntry* findErc20Function(std::string_view function_name) {
+    if (function_name.empty()) return nullptr;
+    const int8_t index = erc20_dispatch_detail::kSlotTable[erc20_dispatch_detail::slotOf(function_name)];
+    if (index < 0 || ERC20_FUNCTIONS[index].name != function_name) return nullptr;
+    return &ERC20_FUNCTIONS[index];
+}
+
+Erc20ContractFunction getErc20ContractFunction(const std::string &function_name) {
+    const Erc20FunctionEntry* entry = findErc20Function(function_name);
+    return entry ? entry->function : Erc20ContractFunction::UNSUPPORTED_FUNCTION;
+}
 
-    ContractOutputs output;
-    auto& contract_result = output.result;
 
+// Calls the token function named by contract_input and fills in the result
+void dispatch_erc20(ERC20& token, const ContractInputs& contract_input, ContractOutputs& output) {
+    auto& result = std::get<Erc20Result>(output.result.result);
+    const Erc20FunctionEntry* entry = nullptr;
+    {
+        VERSATUS_STATS_PHASE(Dispatch);
+        entry = findErc20Function(contract_input.contract_fn);
+    }
+    if (!entry) {
+        result.setType(Erc20Type::EnumUnknown);
+        return;
+    }
+    entry->handler(token, contract_input.function_inputs.erc20, result);
+    if (entry->mutating && !result.success()) output.error = erc20StatusMessage(token.lastStatus());
+}
+
+// Runs one decoded call against token and records its result and events. A
+// call that fails or throws reverts its own writes back to the checkpoint
+// taken here; failures are reported in output.error, exceptions are rethrown.
+void execute_erc20(ERC20& token, const ContractInputs& contract_input, ContractOutputs& output) {
+    VERSATUS_STATS_PHASE(Operation);
+    token.clearEvents();
+    const ERC20::Checkpoint checkpoint = token.checkpoint();
     try {
-        switch (function) {
-            case Erc20ContractFunction::ERC20_ALLOWANCE: {
-                Address owner = contract_input.function_inputs.erc20.allowance.owner;
-                Address spender = contract_input.function_inputs.erc20.allowance.spender;
-
-                contract_result.setType(Erc20Result::Erc20ResultType::EnumAllowance);
-                // Access the result
-                const auto& result = contract_result.getResult();
-                // call allowance
-                // set result
-                //result.erc20Result.value =
-            }
-            break;
-
-            case Erc20ContractFunction::ERC20_APPROVE: {
-                Address address = contract_input.function_inputs.erc20.approve.address;
-                uint256_t value = contract_input.function_inputs.erc20.approve.value;
-                contract_result.setType(Erc20Result::Erc20ResultType::EnumApprove);
-                // call approve
-                // set result
-                //result.erc20Result.value =
-            }
-            break;
+        dispatch_erc20(token, contract_input, output);
+    } catch (...) {
+        token.rollbackTo(checkpoint);
+        throw;
+    }
+    if (!output.error.empty()) token.rollbackTo(checkpoint);
+    output.stateDelta = token.takeChanges().coalesced();
+    token.swapEvents(output.events);
+}
 
-            case Erc20ContractFunction::ERC20_TRANSFER: {
-                Address address = contract_input.function_inputs.erc20.transfer.address;
-                uint256_t value = contract_input.function_inputs.erc20.transfer.value;
-                contract_result.setType(Erc20Result::Erc20ResultType::EnumTransfer);
-                // call transfer
-                // set result
 
-            }
-            break;
-
-            case Erc20ContractFunction::ERC20_TRANSFERFROM: {
-                Address from = contract_input.function_inputs.erc20.transfer_from.from;
-                Address to = contract_input.function_inputs.erc20.transfer_from.to;
-                uint256_t value = contract_input.function_inputs.erc20.transfer_from.value;
-                // call transferFrom
-                contract_result.setType(Erc20Result::Erc20ResultType::EnumTransferFrom);
-                // set result
-            }
-            break;
+void process_erc20(ERC20& token) {
 
-            case Erc20ContractFunction::UNSUPPORTED_FUNCTION:
-                contract_result.setType(Erc20Result::Erc20ResultType::EnumUnknown);
-                break;
+    ContractOutputs output;
+    VERSATUS_STATS_CALLS(1);
 
-            default:
-                throw std::runtime_error("Unsupported erc20 contract function: " + contract_input.contract_fn);
-        }
+    try {
+        // Malformed inputs (bad addresses, missing fields) surface here as exceptions
+        ComputeInputs inputs = ComputeInputs::gather(output.format);
+        execute_erc20(token, inputs.contract_input, output);
     } catch (const std::exception &e) {
             std::cerr << "Contract error: " << e.what() << std::endl;
+            output.error = e.what();
     }
 
     // Commit the smart contract results
     output.commit();
+    VERSATUS_STATS_EMIT();
+
+}
+
+
+// Pending batch output is written once it reaches this size, or sooner when
+// the input has nothing more buffered so an interactive host is not kept waiting
+constexpr size_t BATCH_OUTPUT_FLUSH_BYTES = 64 * 1024;
+
+// Largest binary batch record accepted. A length prefix above it is treated
+// as corrupt and ends the batch before anything is allocated for it.
+constexpr size_t BATCH_MAX_RECORD_BYTES = 16 * 1024 * 1024;
+
+/*
+    Executes a stream of calls against one live token and returns how many
+    records were processed.
+
+    A stream that starts with WIRE_BATCH_MAGIC (plus the format version)
+    holds u32 length-prefixed binary ComputeInputs and is answered with u32
+    length-prefixed binary outputs. Any other stream is read as one JSON
+    ComputeInputs per line and answered with one compact JSON record per
+    line. A record that fails to decode still gets an Unknown result so
+    outputs stay aligned with inputs.
+*/
+size_t process_erc20_batch(ERC20& token, std::istream& in = cin, int out_fd = STDOUT_FILENO) {
+    const bool binary = in.peek() == WIRE_BATCH_MAGIC[0];
+    if (binary) {
+        char header[sizeof(WIRE_BATCH_MAGIC) + 1];
+        try {
+            if (!in.read(header, sizeof(header))) throw std::runtime_error("Wire message truncated");
+            WireReader(std::string_view(header, sizeof(header))).expectMagic(WIRE_BATCH_MAGIC);
+        } catch (const std::exception &e) {
+            std::cerr << "Contract error: " << e.what() << std::endl;
+            return 0;
+        }
+    }
 
+    std::string record;
+    std::string pending;
+    pending.reserve(BATCH_OUTPUT_FLUSH_BYTES + 4096);
+    size_t calls = 0;
+
+    for (;;) {
+        if (binary) {
+            char prefix[4];
+            if (!in.read(prefix, sizeof(prefix))) break;
+            const uint32_t length = WireReader(std::string_view(prefix, sizeof(prefix))).readU32();
+            if (length > BATCH_MAX_RECORD_BYTES) {
+                std::cerr << "Contract error: batch record " << calls << " claims " << length
+                          << " bytes, over the " << BATCH_MAX_RECORD_BYTES << " byte limit" << std::endl;
+                break;
+            }
+            record.resize(length);
+            if (!in.read(record.data(), static_cast<std::streamsize>(record.size()))) {
+                std::cerr << "Contract error: batch record " << calls << " is truncated" << std::endl;
+                break;
+            }
+        } else {
+            if (!std::getline(in, record)) break;
+            if (record.find_first_not_of(" \t\r") == std::string::npos) continue;
+        }
+
+        ContractOutputs output;
+        output.format = binary ? WireFormat::Binary : WireFormat::Json;
+        try {
+            ComputeInputs inputs = [&] {
+                VERSATUS_STATS_PHASE(Gather);
+                VERSATUS_STATS_COUNT(BytesParsed, record.size());
+                return binary ? ComputeInputs::from_binary(record) : ComputeInputs::parse(record);
+            }();
+            execute_erc20(token, inputs.contract_input, output);
+        } catch (const std::exception &e) {
+            std::cerr << "Contract error in batch record " << calls << ": " << e.what() << std::endl;
+            output.error = e.what();
+        }
+        output.appendRecord(pending);
+        // Hand the call's event buffer back so the next call reuses its capacity
+        if (output.events.capacity() > token.events().capacity()) token.swapEvents(output.events);
+        ++calls;
+        VERSATUS_STATS_CALLS(1);
+
+        if (pending.size() >= BATCH_OUTPUT_FLUSH_BYTES || in.rdbuf()->in_avail() <= 0) {
+            writeOutput(pending.data(), pending.size(), out_fd);
+            pending.clear();
+        }
+    }
+
+    writeOutput(pending.data(), pending.size(), out_fd);
+    VERSATUS_STATS_EMIT();
+    return calls;
 }
+
+#endif  // VERSATUS_CPP_ERC20_HPP
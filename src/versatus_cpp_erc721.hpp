@@ -0,0 +1,503 @@
+#ifndef VERSATUS_CPP_ERC721_HPP
+#define VERSATUS_CPP_ERC721_HPP
+
+/*
+    Based on OpenZeppelin
+    https://github.com/OpenZeppelin/openzeppelin-contracts/blob/master/contracts/token/ERC721/ERC721.sol
+    https://github.com/OpenZeppelin/openzeppelin-contracts/blob/master/contracts/token/ERC721/extensions/ERC721Enumerable.sol
+
+    Ownership is kept in two indexes that every write updates together:
+    token id -> slot (owner, single-token approval, and the token's position
+    in its owner's list and in the list of all tokens), and owner -> dense
+    list of the owner's token ids. ownerOf, balanceOf, tokenByIndex and
+    tokenOfOwnerByIndex are one hash lookup plus an array index; a transfer
+    swap-removes the token from the old owner's list and appends it to the
+    new one, so nothing is ever scanned.
+*/
+
+#include "./versatus_cpp_ierc721.hpp"
+#include "./versatus_cpp_flat_map.hpp"
+
+// Token ids are often sequential, so all four limbs go through the AddressHash mixer
+struct TokenIdHash {
+    size_t operator()(const uint256_t& tokenId) const {
+        const Uint256& id = toNativeUint256(tokenId);
+        uint64_t h = AddressHash::hashWords(id.limb(0), id.limb(1), id.limb(2));
+        return static_cast<size_t>(AddressHash::hashWords(h ^ id.limb(3), h, 0));
+    }
+};
+
+// Composite (owner, operator) key, hashed like AllowanceKey
+struct OperatorKey {
+    Address owner;
+    Address operator_;
+
+    bool operator==(const OperatorKey& other) const {
+        return owner == other.owner && operator_ == other.operator_;
+    }
+};
+
+struct OperatorKeyHash {
+    size_t operator()(const OperatorKey& key) const {
+        static_assert(sizeof(OperatorKey) == 2 * ADDRESS_SIZE, "OperatorKey must be packed");
+        uint64_t w[5];
+        std::memcpy(w, &key, sizeof(w));
+        uint64_t h = AddressHash::hashWords(w[0], w[1], w[2]);
+        return static_cast<size_t>(AddressHash::hashWords(h ^ w[3], w[4], h));
+    }
+};
+
+// Outcome of a collection operation, named after OpenZeppelin's custom errors.
+// Failures are reported, never thrown, and leave state untouched.
+enum class Erc721Status : uint8_t {
+    Ok,
+    InvalidSender,
+    InvalidReceiver,
+    InvalidOperator,
+    InvalidApprover,
+    NonexistentToken,
+    IncorrectOwner,
+    InsufficientApproval,
+    OutOfBoundsIndex
+};
+
+const char* erc721StatusMessage(Erc721Status status) {
+    switch (status) {
+        case Erc721Status::Ok: return "ERC721: ok";
+        case Erc721Status::InvalidSender: return "ERC721: ERC721InvalidSender";
+        case Erc721Status::InvalidReceiver: return "ERC721: ERC721InvalidReceiver";
+        case Erc721Status::InvalidOperator: return "ERC721: ERC721InvalidOperator";
+        case Erc721Status::InvalidApprover: return "ERC721: ERC721InvalidApprover";
+        case Erc721Status::NonexistentToken: return "ERC721: ERC721NonexistentToken";
+        case Erc721Status::IncorrectOwner: return "ERC721: ERC721IncorrectOwner";
+        case Erc721Status::InsufficientApproval: return "ERC721: ERC721InsufficientApproval";
+        case Erc721Status::OutOfBoundsIndex: return "ERC721: ERC721OutOfBoundsIndex";
+    }
+    return "ERC721: unknown status";
+}
+
+class ERC721 {
+
+public:
+    // Per-token record; the indexes make removal from both token lists O(1)
+    struct TokenSlot {
+        Address owner;
+        Address approved;
+        uint32_t ownerIndex;
+        uint32_t globalIndex;
+    };
+
+private:
+    std::string name_;
+    std::string symbol_;
+    Erc721Status status_ = Erc721Status::Ok;
+    FlatHashMap<uint256_t, TokenSlot, TokenIdHash> tokens_;
+    FlatHashMap<Address, std::vector<uint256_t>, AddressHash> owned_;
+    FlatHashMap<OperatorKey, bool, OperatorKeyHash> operators_;
+    std::vector<uint256_t> allTokens_;
+    // Events of the current call; mutable because Erc721Token emits from const methods
+    mutable ContractEventBuffer events_;
+
+public:
+
+    ERC721(const std::string& name, const std::string& symbol) : name_(name), symbol_(symbol) {}
+
+    void TransferEvent(const Address &from, const Address &to, uint256_t tokenId) const {
+        events_.append(ContractEvent::Kind::TokenTransfer, from, to, tokenId);
+    }
+
+    void ApprovalEvent(const Address &owner, const Address &approved, uint256_t tokenId) const {
+        events_.append(ContractEvent::Kind::TokenApproval, owner, approved, tokenId);
+    }
+
+    void ApprovalForAllEvent(const Address &owner, const Address &operator_, bool approved) const {
+        events_.append(ContractEvent::Kind::ApprovalForAll, owner, operator_, uint256_t(approved ? 1 : 0));
+    }
+
+    // Events emitted since the buffer was last cleared
+    const ContractEventBuffer& events() const {
+        return events_;
+    }
+
+    void clearEvents() {
+        events_.clear();
+    }
+
+    // Exchanges event buffers, as ERC20::swapEvents does
+    void swapEvents(ContractEventBuffer& other) {
+        events_.swap(other);
+    }
+
+    // ERC721 Metadata
+    std::string name() const {
+        return name_;
+    }
+
+    std::string symbol() const {
+        return symbol_;
+    }
+
+    // Zero for the zero address, which never owns anything
+    uint256_t balanceOf(const Address &owner) const {
+        return uint256_t(static_cast<uint64_t>(tokensOf(owner).size()));
+    }
+
+    // The zero address for a token that does not exist
+    Address ownerOf(uint256_t tokenId) const {
+        auto it = tokens_.find(tokenId);
+        return (it != tokens_.end()) ? it->second.owner : Address{};
+    }
+
+    Address getApproved(uint256_t tokenId) const {
+        auto it = tokens_.find(tokenId);
+        return (it != tokens_.end()) ? it->second.approved : Address{};
+    }
+
+    bool isApprovedForAll(const Address &owner, const Address &operator_) const {
+        return operators_.contains({owner, operator_});
+    }
+
+    uint256_t totalSupply() const {
+        return uint256_t(static_cast<uint64_t>(allTokens_.size()));
+    }
+
+    // Zero when index >= totalSupply(); check the bound first to tell it apart from token 0
+    uint256_t tokenByIndex(uint256_t index) const {
+        std::size_t position;
+        return _position(index, allTokens_.size(), position) ? allTokens_[position] : uint256_t(0);
+    }
+
+    // Zero when index >= balanceOf(owner)
+    uint256_t tokenOfOwnerByIndex(const Address &owner, uint256_t index) const {
+        const std::vector<uint256_t>& tokens = tokensOf(owner);
+        std::size_t position;
+        return _position(index, tokens.size(), position) ? tokens[position] : uint256_t(0);
+    }
+
+    // Every token id owner holds, in tokenOfOwnerByIndex order; stable until the next write
+    const std::vector<uint256_t>& tokensOf(const Address &owner) const {
+        static const std::vector<uint256_t> none;
+        auto it = owned_.find(owner);
+        return (it != owned_.end()) ? it->second : none;
+    }
+
+    const TokenSlot* findToken(const uint256_t& tokenId) const {
+        auto it = tokens_.find(tokenId);
+        return (it != tokens_.end()) ? &it->second : nullptr;
+    }
+
+    // Number of addresses owning at least one token
+    std::size_t holderCount() const {
+        return owned_.size();
+    }
+
+    // Sizes the token indexes for a collection of this many tokens
+    void reserve(std::size_t tokens) {
+        tokens_.reserve(tokens);
+        allTokens_.reserve(tokens);
+    }
+
+    // Why the last state-changing call failed (Ok if it succeeded)
+    Erc721Status lastStatus() const {
+        return status_;
+    }
+
+    // The token's owner, or an operator of the owner, may approve one address for it
+    bool approve(const Address &to, uint256_t tokenId) {
+        auto it = tokens_.find(tokenId);
+        if (it == tokens_.end()) [[unlikely]] return _record(Erc721Status::NonexistentToken);
+        const Address sender = _msgSender();
+        const Address owner = it->second.owner;
+        if (sender != owner && !isApprovedForAll(owner, sender)) [[unlikely]] {
+            return _record(Erc721Status::InvalidApprover);
+        }
+        it->second.approved = to;
+        ApprovalEvent(owner, to, tokenId);
+        return _record(Erc721Status::Ok);
+    }
+
+    bool setApprovalForAll(const Address &operator_, bool approved) {
+        if (operator_ == Address{}) [[unlikely]] return _record(Erc721Status::InvalidOperator);
+        const Address owner = _msgSender();
+        if (approved) {
+            operators_.try_emplace({owner, operator_}, true);
+        } else {
+            operators_.erase({owner, operator_});
+        }
+        ApprovalForAllEvent(owner, operator_, approved);
+        return _record(Erc721Status::Ok);
+    }
+
+    bool transferFrom(const Address &from, const Address &to, uint256_t tokenId) {
+        if (to == Address{}) [[unlikely]] return _record(Erc721Status::InvalidReceiver);
+        auto it = tokens_.find(tokenId);
+        if (it == tokens_.end()) [[unlikely]] return _record(Erc721Status::NonexistentToken);
+        TokenSlot& slot = it->second;
+        const Address sender = _msgSender();
+        if (sender != slot.owner && sender != slot.approved && !isApprovedForAll(slot.owner, sender)) [[unlikely]] {
+            return _record(Erc721Status::InsufficientApproval);
+        }
+        if (slot.owner != from) [[unlikely]] return _record(Erc721Status::IncorrectOwner);
+
+        slot.approved = Address{};
+        if (from != to) {
+            _removeFromOwner(slot);
+            _addToOwner(to, tokenId, slot);
+        }
+        TransferEvent(from, to, tokenId);
+        return _record(Erc721Status::Ok);
+    }
+
+    Erc721Status mint(const Address &to, uint256_t tokenId) {
+        if (to == Address{}) [[unlikely]] return _recordStatus(Erc721Status::InvalidReceiver);
+        if (allTokens_.size() >= UINT32_MAX) [[unlikely]] throw std::length_error("ERC721 collection is full");
+        auto [it, inserted] = tokens_.try_emplace(tokenId);
+        // An existing token means the "from" of the mint is not the zero address
+        if (!inserted) [[unlikely]] return _recordStatus(Erc721Status::InvalidSender);
+        TokenSlot& slot = it->second;
+        slot.approved = Address{};
+        slot.globalIndex = static_cast<uint32_t>(allTokens_.size());
+        allTokens_.push_back(tokenId);
+        _addToOwner(to, tokenId, slot);
+        TransferEvent(Address{}, to, tokenId);
+        return _recordStatus(Erc721Status::Ok);
+    }
+
+    Erc721Status burn(uint256_t tokenId) {
+        auto it = tokens_.find(tokenId);
+        if (it == tokens_.end()) [[unlikely]] return _recordStatus(Erc721Status::NonexistentToken);
+        const Address owner = it->second.owner;
+        _removeFromOwner(it->second);
+
+        // Swap-remove from the global list, moving the last token into the freed position
+        const uint32_t position = it->second.globalIndex;
+        if (position + 1 != allTokens_.size()) {
+            const uint256_t last = allTokens_.back();
+            allTokens_[position] = last;
+            tokens_.find(last)->second.globalIndex = position;
+        }
+        allTokens_.pop_back();
+        tokens_.erase(tokenId);
+        TransferEvent(owner, Address{}, tokenId);
+        return _recordStatus(Erc721Status::Ok);
+    }
+
+private:
+    bool _record(Erc721Status status) {
+        status_ = status;
+        return status == Erc721Status::Ok;
+    }
+
+    Erc721Status _recordStatus(Erc721Status status) {
+        status_ = status;
+        return status;
+    }
+
+    Address _msgSender() const {
+        // TO DO
+        // Replace this with  logic to determine the sender's address
+        Address sender{};
+        sender.fill(0xAA);
+        return sender;
+    }
+
+    // index as a position below size, or false when it is out of bounds
+    static bool _position(const uint256_t& index, std::size_t size, std::size_t& position) {
+        if (index >= uint256_t(static_cast<uint64_t>(size))) return false;
+        position = static_cast<std::size_t>(toNativeUint256(index).low64());
+        return true;
+    }
+
+    void _addToOwner(const Address& owner, const uint256_t& tokenId, TokenSlot& slot) {
+        std::vector<uint256_t>& tokens = owned_[owner];
+        slot.owner = owner;
+        slot.ownerIndex = static_cast<uint32_t>(tokens.size());
+        tokens.push_back(tokenId);
+    }
+
+    // Swap-removes tokenId from its owner's list; an emptied list is dropped
+    void _removeFromOwner(const TokenSlot& slot) {
+        auto owner = owned_.find(slot.owner);
+        std::vector<uint256_t>& tokens = owner->second;
+        if (slot.ownerIndex + 1 != tokens.size()) {
+            const uint256_t last = tokens.back();
+            tokens[slot.ownerIndex] = last;
+            tokens_.find(last)->second.ownerIndex = slot.ownerIndex;
+        }
+        tokens.pop_back();
+        if (tokens.empty()) owned_.erase(owner);
+    }
+};
+
+static_assert(Erc721Token<ERC721>, "ERC721 must offer the IERC721 calls");
+
+
+enum Erc721ContractFunction {
+    ERC721_NAME,
+    ERC721_SYMBOL,
+    ERC721_BALANCEOF,
+    ERC721_OWNEROF,
+    ERC721_GETAPPROVED,
+    ERC721_ISAPPROVEDFORALL,
+    ERC721_TOTALSUPPLY,
+    ERC721_TOKENBYINDEX,
+    ERC721_TOKENOFOWNERBYINDEX,
+    ERC721_APPROVE,
+    ERC721_SETAPPROVALFORALL,
+    ERC721_TRANSFERFROM,
+    UNSUPPORTED_ERC721_FUNCTION
+};
+
+// Executes one call against the collection, fills in its result and returns
+// the status to report (reads fail on a missing token or an index out of bounds)
+using Erc721Handler = Erc721Status (*)(ERC721& token, const ERC721Inputs& inputs, Erc721Result& result);
+
+struct Erc721FunctionEntry {
+    std::string_view name;
+    Erc721ContractFunction function;
+    Erc721Handler handler;
+};
+
+using Erc721Type = Erc721Result::Erc721ResultType;
+
+inline constexpr Erc721FunctionEntry ERC721_FUNCTIONS[] = {
+    {"name", ERC721_NAME, [](ERC721& token, const ERC721Inputs&, Erc721Result& result) {
+        result.setText(Erc721Type::EnumName, token.name());
+        return Erc721Status::Ok;
+    }},
+    {"symbol", ERC721_SYMBOL, [](ERC721& token, const ERC721Inputs&, Erc721Result& result) {
+        result.setText(Erc721Type::EnumSymbol, token.symbol());
+        return Erc721Status::Ok;
+    }},
+    {"balanceOf", ERC721_BALANCEOF, [](ERC721& token, const ERC721Inputs& inputs, Erc721Result& result) {
+        result.setAmount(Erc721Type::EnumBalanceOf, token.balanceOf(inputs.balance_of.owner));
+        return Erc721Status::Ok;
+    }},
+    {"ownerOf", ERC721_OWNEROF, [](ERC721& token, const ERC721Inputs& inputs, Erc721Result& result) {
+        const ERC721::TokenSlot* slot = token.findToken(inputs.owner_of.token_id);
+        result.setAddress(Erc721Type::EnumOwnerOf, slot ? slot->owner : Address{});
+        return slot ? Erc721Status::Ok : Erc721Status::NonexistentToken;
+    }},
+    {"getApproved", ERC721_GETAPPROVED, [](ERC721& token, const ERC721Inputs& inputs, Erc721Result& result) {
+        const ERC721::TokenSlot* slot = token.findToken(inputs.get_approved.token_id);
+        result.setAddress(Erc721Type::EnumGetApproved, slot ? slot->approved : Address{});
+        return slot ? Erc721Status::Ok : Erc721Status::NonexistentToken;
+    }},
+    {"isApprovedForAll", ERC721_ISAPPROVEDFORALL, [](ERC721& token, const ERC721Inputs& inputs, Erc721Result& result) {
+        const auto& query = inputs.is_approved_for_all;
+        result.setFlag(Erc721Type::EnumIsApprovedForAll, token.isApprovedForAll(query.owner, query.operator_address));
+        return Erc721Status::Ok;
+    }},
+    {"totalSupply", ERC721_TOTALSUPPLY, [](ERC721& token, const ERC721Inputs&, Erc721Result& result) {
+        result.setAmount(Erc721Type::EnumTotalSupply, token.totalSupply());
+        return Erc721Status::Ok;
+    }},
+    {"tokenByIndex", ERC721_TOKENBYINDEX, [](ERC721& token, const ERC721Inputs& inputs, Erc721Result& result) {
+        const uint256_t& index = inputs.token_by_index.index;
+        result.setAmount(Erc721Type::EnumTokenByIndex, token.tokenByIndex(index));
+        return index < token.totalSupply() ? Erc721Status::Ok : Erc721Status::OutOfBoundsIndex;
+    }},
+    {"tokenOfOwnerByIndex", ERC721_TOKENOFOWNERBYINDEX,
+     [](ERC721& token, const ERC721Inputs& inputs, Erc721Result& result) {
+        const auto& query = inputs.token_of_owner_by_index;
+        result.setAmount(Erc721Type::EnumTokenOfOwnerByIndex, token.tokenOfOwnerByIndex(query.owner, query.index));
+        return query.index < token.balanceOf(query.owner) ? Erc721Status::Ok : Erc721Status::OutOfBoundsIndex;
+    }},
+    {"approve", ERC721_APPROVE, [](ERC721& token, const ERC721Inputs& inputs, Erc721Result& result) {
+        result.setFlag(Erc721Type::EnumApprove, token.approve(inputs.approve.to, inputs.approve.token_id));
+        return token.lastStatus();
+    }},
+    {"setApprovalForAll", ERC721_SETAPPROVALFORALL, [](ERC721& token, const ERC721Inputs& inputs, Erc721Result& result) {
+        const auto& request = inputs.set_approval_for_all;
+        result.setFlag(Erc721Type::EnumSetApprovalForAll,
+                       token.setApprovalForAll(request.operator_address, request.approved));
+        return token.lastStatus();
+    }},
+    {"transferFrom", ERC721_TRANSFERFROM, [](ERC721& token, const ERC721Inputs& inputs, Erc721Result& result) {
+        const auto& request = inputs.transfer_from;
+        result.setFlag(Erc721Type::EnumTransferFrom, token.transferFrom(request.from, request.to, request.token_id));
+        return token.lastStatus();
+    }},
+};
+
+/*
+    Perfect hash from function name to ERC721_FUNCTIONS index, built like
+    the ERC20 one. The ERC721 names need the last character as well:
+    (5 * length + first + last character) mod 64 is distinct for all of them.
+*/
+namespace erc721_dispatch_detail {
+
+constexpr std::size_t kSlots = 64;
+
+constexpr std::size_t slotOf(std::string_view name) {
+    return (5 * name.size() + static_cast<unsigned char>(name.front()) + static_cast<unsigned char>(name.back())) &
+           (kSlots - 1);
+}
+
+constexpr std::array<int8_t, kSlots> makeSlots() {
+    std::array<int8_t, kSlots> slots{};
+    for (auto& slot : slots) slot = -1;
+    for (std::size_t i = 0; i < std::size(ERC721_FUNCTIONS); ++i) {
+        slots[slotOf(ERC721_FUNCTIONS[i].name)] = static_cast<int8_t>(i);
+    }
+    return slots;
+}
+
+constexpr bool isPerfect() {
+    std::array<int8_t, kSlots> slots = makeSlots();
+    std::size_t used = 0;
+    for (int8_t slot : slots) used += (slot >= 0) ? 1 : 0;
+    return used == std::size(ERC721_FUNCTIONS);
+}
+
+inline constexpr std::array<int8_t, kSlots> kSlotTable = makeSlots();
+static_assert(isPerfect(), "ERC721 function names collide in the dispatch table");
+
+} // namespace erc721_dispatch_detail
+
+// Table entry for function_name, or nullptr when it is not an ERC721 function
+inline const Erc721FunctionEntry* findErc721Function(std::string_view function_name) {
+    if (function_name.empty()) return nullptr;
+    const int8_t index = erc721_dispatch_detail::kSlotTable[erc721_dispatch_detail::slotOf(function_name)];
+    if (index < 0 || ERC721_FUNCTIONS[index].name != function_name) return nullptr;
+    return &ERC721_FUNCTIONS[index];
+}
+
+Erc721ContractFunction getErc721ContractFunction(const std::string &function_name) {
+    const Erc721FunctionEntry* entry = findErc721Function(function_name);
+    return entry ? entry->function : Erc721ContractFunction::UNSUPPORTED_ERC721_FUNCTION;
+}
+
+// Runs one decoded call against the collection and records an Erc721Result
+// and the call's events. Every operation checks before it writes, so a
+// failed call changes nothing, emits nothing and only reports why in output.error.
+void execute_erc721(ERC721& token, const ContractInputs& contract_input, ContractOutputs& output) {
+    token.clearEvents();
+    Erc721Result result;
+    if (const Erc721FunctionEntry* entry = findErc721Function(contract_input.contract_fn)) {
+        const Erc721Status status = entry->handler(token, contract_input.function_inputs.erc721, result);
+        if (status != Erc721Status::Ok) output.error = erc721StatusMessage(status);
+    }
+    output.result.setResult(result);
+    token.swapEvents(output.events);
+}
+
+
+void process_erc721(ERC721& token) {
+
+    ContractOutputs output;
+    output.result.setResult(Erc721Result{});
+
+    try {
+        ComputeInputs inputs = ComputeInputs::gather(output.format);
+        execute_erc721(token, inputs.contract_input, output);
+    } catch (const std::exception &e) {
+            std::cerr << "Contract error: " << e.what() << std::endl;
+            output.error = e.what();
+    }
+
+    output.commit();
+
+}
+
+#endif  // VERSATUS_CPP_ERC721_HPP
@@ -0,0 +1,364 @@
+#ifndef VERSATUS_CPP_FLAT_MAP_HPP
+#define VERSATUS_CPP_FLAT_MAP_HPP
+
+/*
+    Open-addressing hash map with contiguous slots and one control byte per slot.
+
+    Slots are grouped in aligned runs of 16. A lookup hashes the key once,
+    uses the high bits to pick a starting group and the low 7 bits as a tag
+    (H2) that is compared against all 16 control bytes of a group at once
+    (SSE2 natively, SIMD128 under WASM, a plain loop otherwise). Only slots
+    whose tag matches are compared by key, so a lookup usually touches one
+    control line and one slot.
+*/
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <iterator>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#endif
+
+namespace flat_map_detail {
+
+// Control byte states. Full slots hold the 7-bit H2 tag (0..127), so the
+// sign bit alone distinguishes full from empty/deleted.
+constexpr int8_t kEmpty = -128;
+constexpr int8_t kDeleted = -2;
+constexpr std::size_t kGroupWidth = 16;
+
+// Iterates the set bits of a group match mask, lowest slot first
+class BitMask {
+public:
+    explicit BitMask(uint32_t mask) : mask_(mask) {}
+
+    explicit operator bool() const {
+        return mask_ != 0;
+    }
+
+    std::size_t lowest() const {
+        return static_cast<std::size_t>(__builtin_ctz(mask_));
+    }
+
+    void clearLowest() {
+        mask_ &= (mask_ - 1);
+    }
+
+private:
+    uint32_t mask_;
+};
+
+// 16 control bytes loaded for parallel tag comparison
+class Group {
+public:
+    explicit Group(const int8_t* ctrl) {
+#if defined(__SSE2__)
+        ctrl_ = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+#elif defined(__wasm_simd128__)
+        ctrl_ = wasm_v128_load(ctrl);
+#else
+        for (std::size_t i = 0; i < kGroupWidth; ++i) ctrl_[i] = ctrl[i];
+#endif
+    }
+
+    BitMask match(int8_t h2) const {
+#if defined(__SSE2__)
+        return BitMask(static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(ctrl_, _mm_set1_epi8(h2)))));
+#elif defined(__wasm_simd128__)
+        return BitMask(wasm_i8x16_bitmask(wasm_i8x16_eq(ctrl_, wasm_i8x16_splat(h2))));
+#else
+        uint32_t mask = 0;
+        for (std::size_t i = 0; i < kGroupWidth; ++i) {
+            if (ctrl_[i] == h2) mask |= (1u << i);
+        }
+        return BitMask(mask);
+#endif
+    }
+
+    BitMask matchEmpty() const {
+        return match(kEmpty);
+    }
+
+    BitMask matchEmptyOrDeleted() const {
+#if defined(__SSE2__)
+        return BitMask(static_cast<uint32_t>(_mm_movemask_epi8(ctrl_)));
+#elif defined(__wasm_simd128__)
+        return BitMask(wasm_i8x16_bitmask(ctrl_));
+#else
+        uint32_t mask = 0;
+        for (std::size_t i = 0; i < kGroupWidth; ++i) {
+            if (ctrl_[i] < 0) mask |= (1u << i);
+        }
+        return BitMask(mask);
+#endif
+    }
+
+private:
+#if defined(__SSE2__)
+    __m128i ctrl_;
+#elif defined(__wasm_simd128__)
+    v128_t ctrl_;
+#else
+    int8_t ctrl_[kGroupWidth];
+#endif
+};
+
+} // namespace flat_map_detail
+
+template <typename Key, typename Value, typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>>
+class FlatHashMap {
+public:
+    using key_type = Key;
+    using mapped_type = Value;
+    using value_type = std::pair<Key, Value>;
+    using size_type = std::size_t;
+
+private:
+    template <bool Const>
+    class Iter {
+        using Map = std::conditional_t<Const, const FlatHashMap, FlatHashMap>;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = FlatHashMap::value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = std::conditional_t<Const, const value_type*, value_type*>;
+        using reference = std::conditional_t<Const, const value_type&, value_type&>;
+
+        Iter() = default;
+        Iter(Map* map, size_type index) : map_(map), index_(index) {
+            skipFree();
+        }
+
+        // Allow iterator -> const_iterator
+        template <bool C = Const, typename = std::enable_if_t<C>>
+        Iter(const Iter<false>& other) : map_(other.map_), index_(other.index_) {}
+
+        reference operator*() const { return map_->slots_[index_]; }
+        pointer operator->() const { return &map_->slots_[index_]; }
+
+        Iter& operator++() {
+            ++index_;
+            skipFree();
+            return *this;
+        }
+
+        Iter operator++(int) {
+            Iter tmp = *this;
+            ++(*this);
+            return tmp;
+        }
+
+        friend bool operator==(const Iter& a, const Iter& b) { return a.index_ == b.index_; }
+        friend bool operator!=(const Iter& a, const Iter& b) { return a.index_ != b.index_; }
+
+    private:
+        friend class FlatHashMap;
+        template <bool> friend class Iter;
+
+        void skipFree() {
+            while (index_ < map_->capacity_ && map_->ctrl_[index_] < 0) ++index_;
+        }
+
+        Map* map_ = nullptr;
+        size_type index_ = 0;
+    };
+
+public:
+    using iterator = Iter<false>;
+    using const_iterator = Iter<true>;
+
+    FlatHashMap() = default;
+
+    iterator begin() { return iterator(this, 0); }
+    iterator end() { return iterator(this, capacity_); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, capacity_); }
+
+    size_type size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    size_type capacity() const { return capacity_; }
+
+    // Heap bytes owned by the table (control bytes + slots)
+    size_type memoryUsage() const {
+        return ctrl_.capacity() * sizeof(int8_t) + slots_.capacity() * sizeof(value_type);
+    }
+
+    void clear() {
+        ctrl_.clear();
+        slots_.clear();
+        capacity_ = 0;
+        size_ = 0;
+        growthLeft_ = 0;
+    }
+
+    // Empties the table but keeps its allocation, for a map refilled over and over
+    void clearKeepCapacity() {
+        for (size_type i = 0; i < capacity_; ++i) {
+            if (ctrl_[i] >= 0) slots_[i] = value_type{};
+        }
+        std::fill(ctrl_.begin(), ctrl_.end(), flat_map_detail::kEmpty);
+        size_ = 0;
+        growthLeft_ = capacity_ - capacity_ / 8;
+    }
+
+    // Inserts that still fit before the next rehash
+    size_type growthLeft() const { return growthLeft_; }
+
+    // Make room for `count` elements without further rehashing
+    void reserve(size_type count) {
+        if (count > size_ + growthLeft_) rehash(capacityFor(count));
+    }
+
+    iterator find(const Key& key) {
+        return iterator(this, findIndex(key));
+    }
+
+    const_iterator find(const Key& key) const {
+        return const_iterator(this, findIndex(key));
+    }
+
+    bool contains(const Key& key) const {
+        return findIndex(key) != capacity_;
+    }
+
+    size_type count(const Key& key) const {
+        return contains(key) ? 1 : 0;
+    }
+
+    Value& operator[](const Key& key) {
+        return try_emplace(key).first->second;
+    }
+
+    template <typename... Args>
+    std::pair<iterator, bool> try_emplace(const Key& key, Args&&... args) {
+        const size_t hash = hash_(key);
+        size_type index = findIndex(key, hash);
+        if (index != capacity_) return {iterator(this, index), false};
+
+        if (growthLeft_ == 0) rehash(capacityFor(size_ + 1));
+        index = findInsertSlot(hash);
+        if (ctrl_[index] == flat_map_detail::kEmpty) --growthLeft_;
+        ctrl_[index] = h2(hash);
+        slots_[index] = value_type(std::piecewise_construct, std::forward_as_tuple(key),
+                                   std::forward_as_tuple(std::forward<Args>(args)...));
+        ++size_;
+        return {iterator(this, index), true};
+    }
+
+    template <typename V>
+    std::pair<iterator, bool> insert_or_assign(const Key& key, V&& value) {
+        auto result = try_emplace(key);
+        result.first->second = std::forward<V>(value);
+        return result;
+    }
+
+    size_type erase(const Key& key) {
+        size_type index = findIndex(key);
+        if (index == capacity_) return 0;
+        eraseAt(index);
+        return 1;
+    }
+
+    iterator erase(const_iterator pos) {
+        eraseAt(pos.index_);
+        return iterator(this, pos.index_ + 1);
+    }
+
+private:
+    static constexpr std::size_t kGroupWidth = flat_map_detail::kGroupWidth;
+
+    static int8_t h2(size_t hash) {
+        return static_cast<int8_t>(hash & 0x7f);
+    }
+
+    // Smallest power-of-two capacity (in whole groups) keeping load <= 7/8
+    static size_type capacityFor(size_type count) {
+        size_type capacity = kGroupWidth;
+        while (capacity - capacity / 8 < count) capacity *= 2;
+        return capacity;
+    }
+
+    size_type findIndex(const Key& key) const {
+        return findIndex(key, hash_(key));
+    }
+
+    // Returns capacity_ when the key is absent
+    size_type findIndex(const Key& key, size_t hash) const {
+        if (capacity_ == 0) return capacity_;
+        const int8_t tag = h2(hash);
+        const size_type groupMask = capacity_ / kGroupWidth - 1;
+        size_type group = (hash >> 7) & groupMask;
+
+        // Triangular probing over a power-of-two number of groups visits every group
+        for (size_type step = 1;; ++step) {
+            flat_map_detail::Group g(&ctrl_[group * kGroupWidth]);
+            for (auto m = g.match(tag); m; m.clearLowest()) {
+                size_type index = group * kGroupWidth + m.lowest();
+                if (eq_(slots_[index].first, key)) return index;
+            }
+            if (g.matchEmpty()) return capacity_;
+            group = (group + step) & groupMask;
+        }
+    }
+
+    size_type findInsertSlot(size_t hash) const {
+        const size_type groupMask = capacity_ / kGroupWidth - 1;
+        size_type group = (hash >> 7) & groupMask;
+        for (size_type step = 1;; ++step) {
+            flat_map_detail::Group g(&ctrl_[group * kGroupWidth]);
+            if (auto m = g.matchEmptyOrDeleted()) return group * kGroupWidth + m.lowest();
+            group = (group + step) & groupMask;
+        }
+    }
+
+    void eraseAt(size_type index) {
+        // A probe never walks past a group that still has an empty slot, so
+        // the slot can go straight back to empty instead of a tombstone.
+        const size_type groupStart = index & ~(kGroupWidth - 1);
+        if (flat_map_detail::Group(&ctrl_[groupStart]).matchEmpty()) {
+            ctrl_[index] = flat_map_detail::kEmpty;
+            ++growthLeft_;
+        } else {
+            ctrl_[index] = flat_map_detail::kDeleted;
+        }
+        slots_[index] = value_type{};
+        --size_;
+    }
+
+    void rehash(size_type newCapacity) {
+        std::vector<int8_t> oldCtrl = std::exchange(ctrl_, std::vector<int8_t>(newCapacity, flat_map_detail::kEmpty));
+        std::vector<value_type> oldSlots = std::exchange(slots_, std::vector<value_type>(newCapacity));
+        const size_type oldCapacity = capacity_;
+
+        capacity_ = newCapacity;
+        growthLeft_ = newCapacity - newCapacity / 8 - size_;
+
+        for (size_type i = 0; i < oldCapacity; ++i) {
+            if (oldCtrl[i] < 0) continue;
+            const size_t hash = hash_(oldSlots[i].first);
+            size_type index = findInsertSlot(hash);
+            ctrl_[index] = h2(hash);
+            slots_[index] = std::move(oldSlots[i]);
+        }
+    }
+
+    std::vector<int8_t> ctrl_;
+    std::vector<value_type> slots_;
+    size_type capacity_ = 0;
+    size_type size_ = 0;
+    size_type growthLeft_ = 0;
+    Hash hash_;
+    KeyEqual eq_;
+};
+
+#endif  // VERSATUS_CPP_FLAT_MAP_HPP
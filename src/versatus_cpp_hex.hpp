@@ -0,0 +1,106 @@
+#ifndef VERSATUS_CPP_HEX_HPP
+#define VERSATUS_CPP_HEX_HPP
+
+/*
+    Table-driven hex encoding and decoding into caller-provided buffers.
+
+    Encoding writes two characters per byte from a 256-entry pair table;
+    decoding maps each character through a 256-entry nibble table and folds
+    the validity check into the same pass. Nothing here allocates.
+*/
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "./versatus_cpp_uint256.hpp"
+
+namespace hex_detail {
+
+constexpr char kDigits[] = "0123456789abcdef";
+
+// "00".."ff" laid out as 512 contiguous characters
+constexpr std::array<char, 512> makePairTable() {
+    std::array<char, 512> table{};
+    for (std::size_t i = 0; i < 256; ++i) {
+        table[2 * i] = kDigits[i >> 4];
+        table[2 * i + 1] = kDigits[i & 0xf];
+    }
+    return table;
+}
+
+// Nibble value per character, or -1 for non-hex characters
+constexpr std::array<int8_t, 256> makeNibbleTable() {
+    std::array<int8_t, 256> table{};
+    for (std::size_t i = 0; i < 256; ++i) table[i] = -1;
+    for (int i = 0; i < 10; ++i) table['0' + i] = static_cast<int8_t>(i);
+    for (int i = 0; i < 6; ++i) {
+        table['a' + i] = static_cast<int8_t>(10 + i);
+        table['A' + i] = static_cast<int8_t>(10 + i);
+    }
+    return table;
+}
+
+inline constexpr std::array<char, 512> kPairs = makePairTable();
+inline constexpr std::array<int8_t, 256> kNibbles = makeNibbleTable();
+
+} // namespace hex_detail
+
+// Writes 2 * size lowercase hex characters (no prefix, no terminator)
+inline void hexEncode(const uint8_t* bytes, std::size_t size, char* out) {
+    for (std::size_t i = 0; i < size; ++i) {
+        std::memcpy(out + 2 * i, &hex_detail::kPairs[2 * bytes[i]], 2);
+    }
+}
+
+// Decodes 2 * size hex characters into size bytes; false on any non-hex character
+inline bool hexDecode(const char* text, std::size_t size, uint8_t* out) {
+    int bad = 0;
+    for (std::size_t i = 0; i < size; ++i) {
+        int hi = hex_detail::kNibbles[static_cast<uint8_t>(text[2 * i])];
+        int lo = hex_detail::kNibbles[static_cast<uint8_t>(text[2 * i + 1])];
+        bad |= hi | lo;
+        out[i] = static_cast<uint8_t>((hi << 4) | (lo & 0xf));
+    }
+    // Any -1 nibble sets the sign bit of the accumulated mask
+    return bad >= 0;
+}
+
+// Largest number of hex digits in a 256-bit value
+constexpr std::size_t UINT256_HEX_DIGITS = 64;
+
+// Writes the minimal lowercase hex form of value (no prefix, "0" for zero) and returns its length
+inline std::size_t uint256ToHex(const Uint256& value, char* out) {
+    char digits[UINT256_HEX_DIGITS];
+    for (std::size_t l = 0; l < Uint256::kLimbs; ++l) {
+        const uint64_t limb = value.limb(Uint256::kLimbs - 1 - l);
+        for (std::size_t b = 0; b < 8; ++b) {
+            const std::size_t byte = (limb >> (56 - 8 * b)) & 0xff;
+            std::memcpy(digits + l * 16 + b * 2, &hex_detail::kPairs[2 * byte], 2);
+        }
+    }
+
+    std::size_t skip = UINT256_HEX_DIGITS - ((value.bitWidth() + 3) / 4);
+    if (skip == UINT256_HEX_DIGITS) skip = UINT256_HEX_DIGITS - 1;
+    std::size_t length = UINT256_HEX_DIGITS - skip;
+    std::memcpy(out, digits + skip, length);
+    return length;
+}
+
+// Parses 1..64 hex digits (no prefix); false on bad length or characters
+inline bool hexToUint256(const char* text, std::size_t length, Uint256& out) {
+    if (length == 0 || length > UINT256_HEX_DIGITS) return false;
+    uint64_t limbs[4] = {0, 0, 0, 0};
+    int bad = 0;
+    for (std::size_t i = 0; i < length; ++i) {
+        int nibble = hex_detail::kNibbles[static_cast<uint8_t>(text[length - 1 - i])];
+        bad |= nibble;
+        limbs[i / 16] |= static_cast<uint64_t>(nibble & 0xf) << ((i % 16) * 4);
+    }
+    if (bad < 0) return false;
+    out = Uint256::fromLimbs(limbs[0], limbs[1], limbs[2], limbs[3]);
+    return true;
+}
+
+#endif  // VERSATUS_CPP_HEX_HPP
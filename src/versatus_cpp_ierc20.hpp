@@ -1,8 +1,15 @@
 
 /*
     Based on https://github.com/OpenZeppelin/openzeppelin-contracts/blob/master/contracts/token/ERC20/IERC20.sol
+
+    Tokens implement the calls as plain member functions and are checked
+    against the Erc20Token concept, so code templated on the token type
+    resolves (and can inline) every call statically. IERC20 stays as the
+    runtime interface for callers that need one token type behind a
+    pointer; IERC20Adapter puts any Erc20Token behind it.
 */
 
+#include <concepts>
 #include <string>
 #include <array>
 
@@ -30,4 +37,86 @@ public:
     virtual bool transfer(const Address &to, uint256_t value) = 0;
     virtual bool approve(const Address &spender, uint256_t value) = 0;
     virtual bool transferFrom(const Address &from, const Address &to, uint256_t value) = 0;
-};
\ No newline at end of file
+};
+
+template <typename Token>
+concept Erc20Token = requires(Token& token, const Token& view, const Address& account, uint256_t value) {
+    // Events
+    view.TransferEvent(account, account, value);
+    view.ApprovalEvent(account, account, value);
+
+    // Getters
+    { view.name() } -> std::convertible_to<std::string>;
+    { view.symbol() } -> std::convertible_to<std::string>;
+    { view.decimals() } -> std::convertible_to<uint8_t>;
+
+    { view.totalSupply() } -> std::convertible_to<uint256_t>;
+    { view.balanceOf(account) } -> std::convertible_to<uint256_t>;
+    { view.allowance(account, account) } -> std::convertible_to<uint256_t>;
+
+    // Actions
+    { token.transfer(account, value) } -> std::same_as<bool>;
+    { token.approve(account, value) } -> std::same_as<bool>;
+    { token.transferFrom(account, account, value) } -> std::same_as<bool>;
+};
+
+static_assert(Erc20Token<IERC20>, "IERC20 must offer the Erc20Token calls");
+
+// Forwards the IERC20 calls to a token that does not derive from it; the
+// token must outlive the adapter
+template <Erc20Token Token>
+class IERC20Adapter final : public IERC20 {
+public:
+    explicit IERC20Adapter(Token& token) : token_(token) {}
+
+    Token& token() const {
+        return token_;
+    }
+
+    void TransferEvent(const Address &from, const Address &to, uint256_t value) const override {
+        token_.TransferEvent(from, to, value);
+    }
+
+    void ApprovalEvent(const Address &owner, const Address &spender, uint256_t value) const override {
+        token_.ApprovalEvent(owner, spender, value);
+    }
+
+    std::string name() const override {
+        return token_.name();
+    }
+
+    std::string symbol() const override {
+        return token_.symbol();
+    }
+
+    uint8_t decimals() const override {
+        return token_.decimals();
+    }
+
+    uint256_t totalSupply() const override {
+        return token_.totalSupply();
+    }
+
+    uint256_t balanceOf(const Address &account) const override {
+        return token_.balanceOf(account);
+    }
+
+    uint256_t allowance(const Address &owner, const Address &spender) const override {
+        return token_.allowance(owner, spender);
+    }
+
+    bool transfer(const Address &to, uint256_t value) override {
+        return token_.transfer(to, value);
+    }
+
+    bool approve(const Address &spender, uint256_t value) override {
+        return token_.approve(spender, value);
+    }
+
+    bool transferFrom(const Address &from, const Address &to, uint256_t value) override {
+        return token_.transferFrom(from, to, value);
+    }
+
+private:
+    Token& token_;
+};
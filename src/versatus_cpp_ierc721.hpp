@@ -0,0 +1,149 @@
+/*
+    Based on https://github.com/OpenZeppelin/openzeppelin-contracts/blob/master/contracts/token/ERC721/IERC721.sol
+    and https://github.com/OpenZeppelin/openzeppelin-contracts/blob/master/contracts/token/ERC721/extensions/IERC721Enumerable.sol
+
+    Collections are checked against the Erc721Token concept and called
+    statically, as with Erc20Token; IERC721Adapter puts one behind the
+    runtime IERC721 interface.
+*/
+
+#include <concepts>
+#include <string>
+#include <array>
+
+#include "./versatus_cpp.hpp"
+
+
+class IERC721 {
+public:
+    virtual ~IERC721() = default;
+
+    // Events
+    virtual void TransferEvent(const Address &from, const Address &to, uint256_t tokenId) const = 0;
+    virtual void ApprovalEvent(const Address &owner, const Address &approved, uint256_t tokenId) const = 0;
+    virtual void ApprovalForAllEvent(const Address &owner, const Address &operator_, bool approved) const = 0;
+
+    // Getters
+    virtual std::string name() const = 0;
+    virtual std::string symbol() const = 0;
+
+    virtual uint256_t balanceOf(const Address &owner) const = 0;
+    virtual Address ownerOf(uint256_t tokenId) const = 0;
+    virtual Address getApproved(uint256_t tokenId) const = 0;
+    virtual bool isApprovedForAll(const Address &owner, const Address &operator_) const = 0;
+
+    // Enumeration
+    virtual uint256_t totalSupply() const = 0;
+    virtual uint256_t tokenByIndex(uint256_t index) const = 0;
+    virtual uint256_t tokenOfOwnerByIndex(const Address &owner, uint256_t index) const = 0;
+
+    // Actions
+    virtual bool approve(const Address &to, uint256_t tokenId) = 0;
+    virtual bool setApprovalForAll(const Address &operator_, bool approved) = 0;
+    virtual bool transferFrom(const Address &from, const Address &to, uint256_t tokenId) = 0;
+};
+
+template <typename Token>
+concept Erc721Token = requires(Token& token, const Token& view, const Address& account, uint256_t tokenId,
+                               bool approved) {
+    // Events
+    view.TransferEvent(account, account, tokenId);
+    view.ApprovalEvent(account, account, tokenId);
+    view.ApprovalForAllEvent(account, account, approved);
+
+    // Getters
+    { view.name() } -> std::convertible_to<std::string>;
+    { view.symbol() } -> std::convertible_to<std::string>;
+
+    { view.balanceOf(account) } -> std::convertible_to<uint256_t>;
+    { view.ownerOf(tokenId) } -> std::convertible_to<Address>;
+    { view.getApproved(tokenId) } -> std::convertible_to<Address>;
+    { view.isApprovedForAll(account, account) } -> std::same_as<bool>;
+
+    // Enumeration
+    { view.totalSupply() } -> std::convertible_to<uint256_t>;
+    { view.tokenByIndex(tokenId) } -> std::convertible_to<uint256_t>;
+    { view.tokenOfOwnerByIndex(account, tokenId) } -> std::convertible_to<uint256_t>;
+
+    // Actions
+    { token.approve(account, tokenId) } -> std::same_as<bool>;
+    { token.setApprovalForAll(account, approved) } -> std::same_as<bool>;
+    { token.transferFrom(account, account, tokenId) } -> std::same_as<bool>;
+};
+
+static_assert(Erc721Token<IERC721>, "IERC721 must offer the Erc721Token calls");
+
+// Forwards the IERC721 calls to a collection that does not derive from it;
+// the collection must outlive the adapter
+template <Erc721Token Token>
+class IERC721Adapter final : public IERC721 {
+public:
+    explicit IERC721Adapter(Token& token) : token_(token) {}
+
+    Token& token() const {
+        return token_;
+    }
+
+    void TransferEvent(const Address &from, const Address &to, uint256_t tokenId) const override {
+        token_.TransferEvent(from, to, tokenId);
+    }
+
+    void ApprovalEvent(const Address &owner, const Address &approved, uint256_t tokenId) const override {
+        token_.ApprovalEvent(owner, approved, tokenId);
+    }
+
+    void ApprovalForAllEvent(const Address &owner, const Address &operator_, bool approved) const override {
+        token_.ApprovalForAllEvent(owner, operator_, approved);
+    }
+
+    std::string name() const override {
+        return token_.name();
+    }
+
+    std::string symbol() const override {
+        return token_.symbol();
+    }
+
+    uint256_t balanceOf(const Address &owner) const override {
+        return token_.balanceOf(owner);
+    }
+
+    Address ownerOf(uint256_t tokenId) const override {
+        return token_.ownerOf(tokenId);
+    }
+
+    Address getApproved(uint256_t tokenId) const override {
+        return token_.getApproved(tokenId);
+    }
+
+    bool isApprovedForAll(const Address &owner, const Address &operator_) const override {
+        return token_.isApprovedForAll(owner, operator_);
+    }
+
+    uint256_t totalSupply() const override {
+        return token_.totalSupply();
+    }
+
+    uint256_t tokenByIndex(uint256_t index) const override {
+        return token_.tokenByIndex(index);
+    }
+
+    uint256_t tokenOfOwnerByIndex(const Address &owner, uint256_t index) const override {
+        return token_.tokenOfOwnerByIndex(owner, index);
+    }
+
+    bool approve(const Address &to, uint256_t tokenId) override {
+        return token_.approve(to, tokenId);
+    }
+
+    bool setApprovalForAll(const Address &operator_, bool approved) override {
+        return token_.setApprovalForAll(operator_, approved);
+    }
+
+    bool transferFrom(const Address &from, const Address &to, uint256_t tokenId) override {
+        return token_.transferFrom(from, to, tokenId);
+    }
+
+private:
+    Token& token_;
+};
@@ -0,0 +1,201 @@
+#ifndef VERSATUS_CPP_JOURNAL_HPP
+#define VERSATUS_CPP_JOURNAL_HPP
+
+/*
+    Append-only journal of ERC20 state deltas.
+
+    The file starts with WIRE_JOURNAL_MAGIC and JOURNAL_FORMAT_VERSION,
+    then holds one u32 length-prefixed Erc20ChangeSet per committed call.
+    Records are appended on an O_APPEND descriptor, so a crash can only
+    leave a torn last record (or a torn header), which replay stops at and
+    the next open cuts off before appending. A write that fails is
+    cut back off the file and reported as std::runtime_error; the journal
+    never drops a record quietly.
+
+    With JournalSync::EveryRecord (the default) append() returns only once
+    the record is on stable storage. JournalSync::Manual leaves that to
+    sync(), trading the records since the last sync on power loss for
+    throughput; a process crash alone still loses nothing.
+
+    Replaying a journal over the snapshot it was started from rebuilds the
+    latest state without ever rewriting the whole ledger.
+*/
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <fstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "./versatus_cpp.hpp"
+#include "./versatus_cpp_snapshot.hpp"
+
+constexpr char WIRE_JOURNAL_MAGIC[4] = {'V', 'R', 'S', 'J'};
+// Versioned apart from WIRE_FORMAT_VERSION: only an Erc20ChangeSet layout
+// change makes existing journals unreadable
+constexpr uint8_t JOURNAL_FORMAT_VERSION = 1;
+
+enum class JournalSync : uint8_t {
+    EveryRecord,
+    Manual
+};
+
+class Erc20Journal {
+public:
+    // Opens (creating if needed) the journal at path, dropping a torn tail
+    // left by a crash; throws std::runtime_error on failure
+    explicit Erc20Journal(const std::string& path, JournalSync sync = JournalSync::EveryRecord)
+        : path_(path), sync_(sync) {
+        fd_ = ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND, 0644);
+        if (fd_ < 0) throw std::runtime_error("Cannot open journal " + path);
+        try {
+            _recover();
+            if (size_ == 0) {
+                _write(_header());
+                // The new file's directory entry has to survive as well
+                if (sync_ == JournalSync::EveryRecord) syncSnapshotDirectory(path_);
+            }
+        } catch (...) {
+            ::close(fd_);
+            throw;
+        }
+    }
+
+    Erc20Journal(Erc20Journal&& other) noexcept
+        : path_(std::move(other.path_)), sync_(other.sync_), fd_(std::exchange(other.fd_, -1)),
+          size_(other.size_) {}
+    Erc20Journal(const Erc20Journal&) = delete;
+    Erc20Journal& operator=(const Erc20Journal&) = delete;
+
+    ~Erc20Journal() {
+        if (fd_ >= 0) ::close(fd_);
+    }
+
+    // Appends one record; empty change sets are skipped
+    void append(const Erc20ChangeSet& changes) {
+        if (changes.empty()) return;
+        record_.clear();
+        WireWriter w(record_);
+        w.writeU32(0);
+        changes.to_wire(w);
+        const uint32_t size = static_cast<uint32_t>(record_.size() - sizeof(uint32_t));
+        for (std::size_t i = 0; i < sizeof(size); ++i) record_[i] = static_cast<char>(size >> (8 * i));
+        _write(record_);
+    }
+
+    // Flushes every appended record to stable storage
+    void sync() {
+        if (::fsync(fd_) != 0) throw std::runtime_error("Cannot sync journal " + path_);
+    }
+
+    // Calls fn(const Erc20ChangeSet&) for every complete record in order and
+    // returns how many there were; a torn final record is ignored
+    template <typename Fn>
+    static std::size_t replay(const std::string& path, Fn&& fn) {
+        std::ifstream in(path, std::ios::binary);
+        if (!in) throw std::runtime_error("Cannot open journal " + path);
+        const std::string data{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+
+        WireReader r(data);
+        r.expectMagic(WIRE_JOURNAL_MAGIC, JOURNAL_FORMAT_VERSION);
+        std::size_t count = 0;
+        while (r.remaining() >= sizeof(uint32_t)) {
+            const uint32_t size = r.readU32();
+            if (size > r.remaining()) break;
+            WireReader record(std::string_view(r.readBytes(size), size));
+            Erc20ChangeSet changes;
+            changes.from_wire(record);
+            fn(changes);
+            ++count;
+        }
+        return count;
+    }
+
+private:
+    static std::string _header() {
+        std::string header;
+        WireWriter w(header);
+        w.writeBytes(WIRE_JOURNAL_MAGIC, sizeof(WIRE_JOURNAL_MAGIC));
+        w.writeU8(JOURNAL_FORMAT_VERSION);
+        return header;
+    }
+
+    // Sets size_ to the end of the last complete record, scanning the
+    // length prefixes as replay() does, and cuts off whatever a crash left
+    // behind it. A header that never finished leaves nothing (the header is
+    // written again); a file that is not a journal of this version throws
+    // instead of being truncated.
+    void _recover() {
+        struct stat info;
+        if (::fstat(fd_, &info) != 0) throw std::runtime_error("Cannot stat journal " + path_);
+        const off_t fileSize = info.st_size;
+
+        const std::string expected = _header();
+        std::string header(static_cast<std::size_t>(std::min<off_t>(fileSize, expected.size())), '\0');
+        _readAt(header.data(), header.size(), 0);
+        if (expected.compare(0, header.size(), header) != 0) {
+            throw std::runtime_error("Journal " + path_ + " has an unsupported header");
+        }
+        size_ = (header.size() == expected.size()) ? static_cast<off_t>(header.size()) : 0;
+        char prefix[sizeof(uint32_t)];
+        while (fileSize - size_ >= static_cast<off_t>(sizeof(prefix))) {
+            _readAt(prefix, sizeof(prefix), size_);
+            const uint32_t size = WireReader(std::string_view(prefix, sizeof(prefix))).readU32();
+            if (size > fileSize - size_ - static_cast<off_t>(sizeof(prefix))) break;
+            size_ += static_cast<off_t>(sizeof(prefix) + size);
+        }
+        if (size_ != fileSize) {
+            if (::ftruncate(fd_, size_) != 0) throw std::runtime_error("Cannot truncate journal " + path_);
+            sync();
+        }
+    }
+
+    void _readAt(char* data, std::size_t size, off_t offset) {
+        std::size_t done = 0;
+        while (done < size) {
+            ssize_t got = ::pread(fd_, data + done, size - done, offset + static_cast<off_t>(done));
+            if (got < 0 && errno == EINTR) continue;
+            if (got <= 0) throw std::runtime_error("Cannot read journal " + path_);
+            done += static_cast<std::size_t>(got);
+        }
+    }
+
+    // Appends data whole, resuming after short writes and interrupts. On any
+    // other error the partial tail is truncated away, so later records are
+    // not appended behind a torn one.
+    void _write(std::string_view data) {
+        std::size_t done = 0;
+        while (done < data.size()) {
+            ssize_t written = ::write(fd_, data.data() + done, data.size() - done);
+            if (written < 0 && errno == EINTR) continue;
+            if (written <= 0) {
+                const int error = written < 0 ? errno : EIO;
+                if (done != 0 && ::ftruncate(fd_, size_) != 0) {
+                    throw std::runtime_error("Journal " + path_ + " has a torn record that cannot be removed");
+                }
+                throw std::runtime_error("Cannot append to journal " + path_ + ": " + std::strerror(error));
+            }
+            done += static_cast<std::size_t>(written);
+        }
+        size_ += static_cast<off_t>(data.size());
+        if (sync_ == JournalSync::EveryRecord) sync();
+    }
+
+    std::string path_;
+    JournalSync sync_;
+    int fd_ = -1;
+    // Length of the file up to the last complete record
+    off_t size_ = 0;
+    std::string record_;
+};
+
+#endif  // VERSATUS_CPP_JOURNAL_HPP
@@ -0,0 +1,152 @@
+#ifndef VERSATUS_CPP_PARALLEL_HPP
+#define VERSATUS_CPP_PARALLEL_HPP
+
+/*
+    Optimistic parallel execution of a batch of ERC20 calls.
+
+    Every call first runs speculatively, spread over the worker threads, on
+    a view of the token as it stood before the batch; the view logs every
+    ledger slot the call read. Calls are then committed strictly in batch
+    order. A call that read no slot written by an earlier call of the batch
+    saw exactly the state sequential execution would have given it, so its
+    recorded writes are applied as they are. Any other call is executed
+    again, in order, on the live token. Outputs and the final ledger are
+    therefore identical to running the calls one after another.
+
+    Every ERC20 write reads its slot first (for the change set's `before`),
+    so the read set covers the write set and validating reads is enough.
+    No call's writes or events depend on where keys sit in a table (batch
+    credits follow the input order), so a view, whose tables are sized
+    differently from the token's, records them in the same order.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include "./versatus_cpp_erc20.hpp"
+
+class Erc20ParallelExecutor {
+public:
+    // threads == 0 uses one per hardware thread
+    explicit Erc20ParallelExecutor(unsigned threads = 0)
+        : threads_(threads ? threads : std::max(1u, std::thread::hardware_concurrency())) {}
+
+    unsigned threads() const {
+        return threads_;
+    }
+
+    // Calls the last execute() had to run a second time because of a conflict
+    std::size_t reexecuted() const {
+        return reexecuted_;
+    }
+
+    // Executes calls against token, filling outputs[i] for calls[i]. A call
+    // that throws gets the exception text in output.error, as in
+    // process_erc20_batch. token must not be used elsewhere until this returns.
+    void execute(ERC20& token, std::span<const ContractInputs> calls, std::vector<ContractOutputs>& outputs) {
+        outputs.clear();
+        outputs.resize(calls.size());
+        reads_.resize(std::max(reads_.size(), calls.size()));
+        reexecuted_ = 0;
+
+        // One thread has nothing to overlap speculation with, so it just runs the calls in order
+        if (threads_ == 1) {
+            for (std::size_t i = 0; i < calls.size(); ++i) _run(token, calls[i], outputs[i]);
+            return;
+        }
+
+        _speculate(token, calls, outputs);
+
+        writtenBalances_.clearKeepCapacity();
+        writtenAllowances_.clearKeepCapacity();
+        // A call usually writes two balances (a transfer's sender and receiver)
+        writtenBalances_.reserve(2 * calls.size());
+        bool writtenSupply = false;
+        for (std::size_t i = 0; i < calls.size(); ++i) {
+            if (_conflicts(reads_[i], writtenSupply)) {
+                ++reexecuted_;
+                _clear(outputs[i]);
+                _run(token, calls[i], outputs[i]);
+            } else {
+                token.applyChanges(outputs[i].stateDelta);
+            }
+            for (const auto& change : outputs[i].stateDelta) {
+                switch (change.slot) {
+                    case Erc20StateChange::Slot::Balance: writtenBalances_.try_emplace(change.account); break;
+                    case Erc20StateChange::Slot::Allowance:
+                        writtenAllowances_.try_emplace(AllowanceKey{change.account, change.spender});
+                        break;
+                    case Erc20StateChange::Slot::TotalSupply: writtenSupply = true; break;
+                }
+            }
+        }
+    }
+
+private:
+    // Runs every call on a per-thread view of token; calls are handed out in
+    // small chunks so uneven calls still spread evenly
+    void _speculate(const ERC20& token, std::span<const ContractInputs> calls, std::vector<ContractOutputs>& outputs) {
+        constexpr std::size_t kChunk = 64;
+        std::atomic<std::size_t> next{0};
+        auto worker = [&] {
+            Erc20ReadSet unused;
+            ERC20 view = token.speculativeView(unused);
+            for (;;) {
+                const std::size_t begin = next.fetch_add(kChunk, std::memory_order_relaxed);
+                if (begin >= calls.size()) break;
+                const std::size_t end = std::min(begin + kChunk, calls.size());
+                for (std::size_t i = begin; i < end; ++i) {
+                    reads_[i].clear();
+                    view._resetView(reads_[i]);
+                    _run(view, calls[i], outputs[i]);
+                }
+            }
+        };
+
+        const unsigned threads = static_cast<unsigned>(std::min<std::size_t>(threads_, (calls.size() + kChunk - 1) / kChunk));
+        std::vector<std::thread> pool;
+        pool.reserve(threads > 0 ? threads - 1 : 0);
+        for (unsigned t = 1; t < threads; ++t) pool.emplace_back(worker);
+        worker();
+        for (auto& thread : pool) thread.join();
+    }
+
+    static void _run(ERC20& token, const ContractInputs& call, ContractOutputs& output) {
+        try {
+            execute_erc20(token, call, output);
+        } catch (const std::exception& e) {
+            output.error = e.what();
+        }
+    }
+
+    static void _clear(ContractOutputs& output) {
+        output.result.setResult(Erc20Result{});
+        output.stateDelta.clear();
+        output.error.clear();
+        output.events.clear();
+    }
+
+    bool _conflicts(const Erc20ReadSet& reads, bool writtenSupply) const {
+        if (reads.totalSupply && writtenSupply) return true;
+        for (const auto& account : reads.balances) {
+            if (writtenBalances_.contains(account)) return true;
+        }
+        for (const auto& key : reads.allowances) {
+            if (writtenAllowances_.contains(key)) return true;
+        }
+        return false;
+    }
+
+    unsigned threads_;
+    std::size_t reexecuted_ = 0;
+    // What each call of the batch read during speculation
+    std::vector<Erc20ReadSet> reads_;
+    FlatHashMap<Address, bool, AddressHash> writtenBalances_;
+    FlatHashMap<AllowanceKey, bool, AllowanceKeyHash> writtenAllowances_;
+};
+
+#endif  // VERSATUS_CPP_PARALLEL_HPP
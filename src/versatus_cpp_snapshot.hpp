@@ -0,0 +1,434 @@
+#ifndef VERSATUS_CPP_SNAPSHOT_HPP
+#define VERSATUS_CPP_SNAPSHOT_HPP
+
+/*
+    Memory-mappable ERC20 state snapshot.
+
+    A snapshot file is a fixed header followed by two arrays of fixed-width
+    records: balances sorted by account, then allowances sorted by
+    (owner, spender). Values are stored as native Uint256 limbs, so a mapped
+    file is used as-is: opening it validates the header and sizes and
+    nothing else, and lookups binary-search the mapped records.
+
+    Records whose value is zero are allowed; they are what an in-place
+    update leaves behind when a balance or allowance is spent down, and
+    they read as absent. A full rewrite drops them.
+
+    An in-place update is first written, checksummed and synced to a patch
+    file beside the snapshot (path + ".patch"), then applied and removed.
+    Opening a snapshot finishes a patch a crash left behind and discards a
+    torn one, so the records never disagree with the header.
+*/
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "./versatus_cpp.hpp"
+
+constexpr char SNAPSHOT_MAGIC[4] = {'V', 'R', 'S', 'S'};
+constexpr uint32_t SNAPSHOT_VERSION = 1;
+// Written in native order; a file from a host with the other byte order fails to open
+constexpr uint32_t SNAPSHOT_BYTE_ORDER_MARK = 0x01020304;
+
+constexpr std::size_t SNAPSHOT_NAME_CAPACITY = 64;
+constexpr std::size_t SNAPSHOT_SYMBOL_CAPACITY = 32;
+
+struct SnapshotHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint8_t decimals;
+    uint8_t nameLength;
+    uint8_t symbolLength;
+    uint8_t reserved;
+    char name[SNAPSHOT_NAME_CAPACITY];
+    char symbol[SNAPSHOT_SYMBOL_CAPACITY];
+    Uint256 totalSupply;
+    uint64_t balanceCount;
+    uint64_t allowanceCount;
+    // Records with a non-zero value
+    uint64_t holderCount;
+    uint64_t allowanceEntryCount;
+};
+
+struct BalanceRecord {
+    Address account;
+    uint8_t padding[4];
+    Uint256 value;
+};
+
+struct AllowanceRecord {
+    Address owner;
+    Address spender;
+    Uint256 value;
+};
+
+static_assert(std::is_trivially_copyable_v<SnapshotHeader>, "SnapshotHeader must be mappable");
+static_assert(sizeof(SnapshotHeader) % alignof(Uint256) == 0, "records must start aligned");
+static_assert(sizeof(BalanceRecord) == 56, "BalanceRecord layout is part of the file format");
+static_assert(sizeof(AllowanceRecord) == 72, "AllowanceRecord layout is part of the file format");
+
+constexpr char SNAPSHOT_PATCH_MAGIC[4] = {'V', 'R', 'S', 'P'};
+constexpr uint32_t SNAPSHOT_PATCH_VERSION = 1;
+
+inline int compareAddresses(const Address& a, const Address& b) {
+    return std::memcmp(a.data(), b.data(), ADDRESS_SIZE);
+}
+
+// pwrite(2) the whole buffer at offset; throws std::runtime_error on failure
+inline void writeSnapshotAt(int fd, const void* data, std::size_t size, off_t offset) {
+    const char* bytes = static_cast<const char*>(data);
+    while (size > 0) {
+        ssize_t written = ::pwrite(fd, bytes, size, offset);
+        if (written < 0 && errno == EINTR) continue;
+        if (written <= 0) throw std::runtime_error("Snapshot write failed");
+        bytes += written;
+        size -= static_cast<std::size_t>(written);
+        offset += written;
+    }
+}
+
+// Flushes fd to stable storage; throws std::runtime_error naming path on failure
+inline void syncSnapshotFile(int fd, const std::string& path) {
+    if (::fsync(fd) != 0) throw std::runtime_error("Cannot sync " + path);
+}
+
+// Makes a create, rename or unlink in path's directory durable
+inline void syncSnapshotDirectory(const std::string& path) {
+    const std::size_t slash = path.rfind('/');
+    const std::string dir = slash == std::string::npos ? "." : slash == 0 ? "/" : path.substr(0, slash);
+    int fd = ::open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) throw std::runtime_error("Cannot open directory " + dir);
+    // Some file systems cannot sync a directory; their metadata is ordered anyway
+    const bool synced = ::fsync(fd) == 0 || errno == EINVAL;
+    ::close(fd);
+    if (!synced) throw std::runtime_error("Cannot sync directory " + dir);
+}
+
+inline std::string snapshotPatchPath(const std::string& path) {
+    return path + ".patch";
+}
+
+// FNV-1a; tells a fully written patch from one torn by a crash
+inline uint64_t snapshotPatchChecksum(std::string_view data) {
+    uint64_t hash = 0xcbf29ce484222325;
+    for (char c : data) hash = (hash ^ static_cast<uint8_t>(c)) * 0x100000001b3;
+    return hash;
+}
+
+/*
+    Byte ranges to overwrite in a snapshot of a known size. The patch file
+    is SNAPSHOT_PATCH_MAGIC, the version, the snapshot size and the entry
+    count, then (u64 offset, u32 size, bytes) per entry, then a u64
+    checksum of everything before it.
+*/
+class SnapshotPatch {
+public:
+    explicit SnapshotPatch(uint64_t fileSize) : fileSize_(fileSize) {}
+
+    void add(std::size_t offset, const void* data, std::size_t size) {
+        WireWriter w(entries_);
+        w.writeU64(offset);
+        w.writeU32(static_cast<uint32_t>(size));
+        w.writeBytes(data, size);
+        ++count_;
+    }
+
+    // Writes and syncs the patch file; once this returns the update survives a crash
+    void commit(const std::string& path) const {
+        std::string data;
+        WireWriter w(data);
+        w.writeBytes(SNAPSHOT_PATCH_MAGIC, sizeof(SNAPSHOT_PATCH_MAGIC));
+        w.writeU32(SNAPSHOT_PATCH_VERSION);
+        w.writeU64(fileSize_);
+        w.writeU64(count_);
+        w.writeBytes(entries_.data(), entries_.size());
+        w.writeU64(snapshotPatchChecksum(data));
+
+        const std::string patchPath = snapshotPatchPath(path);
+        int fd = ::open(patchPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) throw std::runtime_error("Cannot create snapshot patch " + patchPath);
+        try {
+            writeSnapshotAt(fd, data.data(), data.size(), 0);
+            syncSnapshotFile(fd, patchPath);
+        } catch (...) {
+            ::close(fd);
+            throw;
+        }
+        ::close(fd);
+        syncSnapshotDirectory(patchPath);
+    }
+
+    // Writes every entry into the open snapshot fd and syncs it
+    void apply(int fd, const std::string& path) const {
+        WireReader r(entries_);
+        for (uint64_t i = 0; i < count_; ++i) {
+            const uint64_t offset = r.readU64();
+            const uint32_t size = r.readU32();
+            writeSnapshotAt(fd, r.readBytes(size), size, static_cast<off_t>(offset));
+        }
+        syncSnapshotFile(fd, path);
+    }
+
+    // The patch stored in data, or false when it is torn, corrupt or meant
+    // for a file of another size
+    static bool parse(std::string_view data, uint64_t fileSize, SnapshotPatch& out) {
+        if (data.size() < sizeof(uint64_t)) return false;
+        const std::size_t body = data.size() - sizeof(uint64_t);
+        try {
+            WireReader checksum(data.substr(body));
+            if (checksum.readU64() != snapshotPatchChecksum(data.substr(0, body))) return false;
+            WireReader r(data.substr(0, body));
+            if (std::memcmp(r.readBytes(sizeof(SNAPSHOT_PATCH_MAGIC)), SNAPSHOT_PATCH_MAGIC,
+                            sizeof(SNAPSHOT_PATCH_MAGIC)) != 0 ||
+                r.readU32() != SNAPSHOT_PATCH_VERSION || r.readU64() != fileSize) {
+                return false;
+            }
+            const uint64_t count = r.readU64();
+            const std::size_t size = r.remaining();
+            const std::string_view entries(r.readBytes(size), size);
+            // Check every range before anything is written
+            WireReader check(entries);
+            for (uint64_t i = 0; i < count; ++i) {
+                const uint64_t offset = check.readU64();
+                const uint32_t length = check.readU32();
+                check.readBytes(length);
+                if (offset > fileSize || length > fileSize - offset) return false;
+            }
+            if (check.remaining() != 0) return false;
+            SnapshotPatch patch(fileSize);
+            patch.entries_.assign(entries);
+            patch.count_ = count;
+            out = std::move(patch);
+        } catch (const std::runtime_error&) {
+            return false;
+        }
+        return true;
+    }
+
+private:
+    uint64_t fileSize_;
+    uint64_t count_ = 0;
+    std::string entries_;
+};
+
+// Finishes or discards the patch an interrupted in-place update left beside path
+inline void recoverSnapshotPatch(const std::string& path) {
+    const std::string patchPath = snapshotPatchPath(path);
+    std::ifstream in(patchPath, std::ios::binary);
+    if (!in) return;
+    const std::string data{std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>()};
+    in.close();
+
+    int fd = ::open(path.c_str(), O_WRONLY);
+    if (fd < 0) throw std::runtime_error("Cannot open snapshot " + path);
+    try {
+        struct stat info;
+        if (::fstat(fd, &info) != 0) throw std::runtime_error("Cannot stat snapshot " + path);
+        // A torn patch was never committed, so the snapshot was not touched
+        SnapshotPatch patch(0);
+        if (SnapshotPatch::parse(data, static_cast<uint64_t>(info.st_size), patch)) patch.apply(fd, path);
+    } catch (...) {
+        ::close(fd);
+        throw;
+    }
+    ::close(fd);
+    if (::unlink(patchPath.c_str()) != 0) throw std::runtime_error("Cannot remove snapshot patch " + patchPath);
+    syncSnapshotDirectory(patchPath);
+}
+
+// Read-only mapping of a snapshot file; move-only, unmaps on destruction.
+// A default-constructed snapshot is empty and every lookup returns zero.
+class Erc20Snapshot {
+public:
+    Erc20Snapshot() = default;
+
+    // Maps path and validates its header; throws std::runtime_error on a bad file.
+    // A patch left by an interrupted in-place update is finished first.
+    static Erc20Snapshot open(const std::string& path) {
+        recoverSnapshotPatch(path);
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) throw std::runtime_error("Cannot open snapshot " + path);
+        struct stat info;
+        if (::fstat(fd, &info) != 0 || static_cast<std::size_t>(info.st_size) < sizeof(SnapshotHeader)) {
+            ::close(fd);
+            throw std::runtime_error("Snapshot " + path + " is truncated");
+        }
+        const std::size_t size = static_cast<std::size_t>(info.st_size);
+        void* data = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+        if (data == MAP_FAILED) throw std::runtime_error("Cannot map snapshot " + path);
+
+        Erc20Snapshot snapshot;
+        snapshot.data_ = static_cast<const uint8_t*>(data);
+        snapshot.size_ = size;
+        snapshot.path_ = path;
+
+        const SnapshotHeader& h = snapshot.header();
+        if (std::memcmp(h.magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0 || h.version != SNAPSHOT_VERSION ||
+            h.byteOrder != SNAPSHOT_BYTE_ORDER_MARK) {
+            throw std::runtime_error("Snapshot " + path + " has an unsupported header");
+        }
+        if (h.nameLength > SNAPSHOT_NAME_CAPACITY || h.symbolLength > SNAPSHOT_SYMBOL_CAPACITY ||
+            !matchesSize(h, size)) {
+            throw std::runtime_error("Snapshot " + path + " does not match its header");
+        }
+        return snapshot;
+    }
+
+    Erc20Snapshot(Erc20Snapshot&& other) noexcept
+        : data_(std::exchange(other.data_, nullptr)), size_(std::exchange(other.size_, 0)),
+          path_(std::move(other.path_)) {}
+
+    Erc20Snapshot& operator=(Erc20Snapshot&& other) noexcept {
+        if (this != &other) {
+            unmap();
+            data_ = std::exchange(other.data_, nullptr);
+            size_ = std::exchange(other.size_, 0);
+            path_ = std::move(other.path_);
+        }
+        return *this;
+    }
+
+    Erc20Snapshot(const Erc20Snapshot&) = delete;
+    Erc20Snapshot& operator=(const Erc20Snapshot&) = delete;
+
+    ~Erc20Snapshot() {
+        unmap();
+    }
+
+    explicit operator bool() const {
+        return data_ != nullptr;
+    }
+
+    const std::string& path() const {
+        return path_;
+    }
+
+    const SnapshotHeader& header() const {
+        return *reinterpret_cast<const SnapshotHeader*>(data_);
+    }
+
+    const BalanceRecord* balancesBegin() const {
+        return data_ ? reinterpret_cast<const BalanceRecord*>(data_ + sizeof(SnapshotHeader)) : nullptr;
+    }
+
+    const BalanceRecord* balancesEnd() const {
+        return data_ ? balancesBegin() + header().balanceCount : nullptr;
+    }
+
+    const AllowanceRecord* allowancesBegin() const {
+        return data_ ? reinterpret_cast<const AllowanceRecord*>(balancesEnd()) : nullptr;
+    }
+
+    const AllowanceRecord* allowancesEnd() const {
+        return data_ ? allowancesBegin() + header().allowanceCount : nullptr;
+    }
+
+    // Record for account, or nullptr
+    const BalanceRecord* findBalance(const Address& account) const {
+        const BalanceRecord* it = std::lower_bound(balancesBegin(), balancesEnd(), account,
+            [](const BalanceRecord& record, const Address& key) { return compareAddresses(record.account, key) < 0; });
+        return (it != balancesEnd() && it->account == account) ? it : nullptr;
+    }
+
+    const AllowanceRecord* findAllowance(const Address& owner, const Address& spender) const {
+        const AllowanceRecord* it = lowerBoundAllowance(owner, spender);
+        return (it != allowancesEnd() && it->owner == owner && it->spender == spender) ? it : nullptr;
+    }
+
+    // First allowance record not ordered before (owner, spender)
+    const AllowanceRecord* lowerBoundAllowance(const Address& owner, const Address& spender) const {
+        return std::lower_bound(allowancesBegin(), allowancesEnd(), std::make_pair(owner, spender),
+            [](const AllowanceRecord& record, const std::pair<Address, Address>& key) {
+                int order = compareAddresses(record.owner, key.first);
+                return order != 0 ? order < 0 : compareAddresses(record.spender, key.second) < 0;
+            });
+    }
+
+    uint256_t balanceOf(const Address& account) const {
+        const BalanceRecord* record = findBalance(account);
+        return record ? uint256_t(fromNativeUint256(record->value)) : uint256_t(0);
+    }
+
+    uint256_t allowance(const Address& owner, const Address& spender) const {
+        const AllowanceRecord* record = findAllowance(owner, spender);
+        return record ? uint256_t(fromNativeUint256(record->value)) : uint256_t(0);
+    }
+
+    // Byte offsets of records, used to patch a file in place
+    std::size_t offsetOf(const BalanceRecord* record) const {
+        return reinterpret_cast<const uint8_t*>(record) - data_;
+    }
+
+    std::size_t offsetOf(const AllowanceRecord* record) const {
+        return reinterpret_cast<const uint8_t*>(record) - data_;
+    }
+
+    static std::size_t fileSize(uint64_t balanceCount, uint64_t allowanceCount) {
+        return sizeof(SnapshotHeader) + balanceCount * sizeof(BalanceRecord) +
+               allowanceCount * sizeof(AllowanceRecord);
+    }
+
+private:
+    // Whether size is exactly the header plus h's records. The counts are
+    // bounded by the bytes left before multiplying, so a corrupt header
+    // cannot wrap fileSize() around to the real size.
+    static bool matchesSize(const SnapshotHeader& h, std::size_t size) {
+        std::size_t remaining = size - sizeof(SnapshotHeader);
+        if (h.balanceCount > remaining / sizeof(BalanceRecord)) return false;
+        remaining -= h.balanceCount * sizeof(BalanceRecord);
+        if (h.allowanceCount > remaining / sizeof(AllowanceRecord)) return false;
+        return remaining == h.allowanceCount * sizeof(AllowanceRecord);
+    }
+
+    void unmap() {
+        if (data_) ::munmap(const_cast<uint8_t*>(data_), size_);
+        data_ = nullptr;
+        size_ = 0;
+    }
+
+    const uint8_t* data_ = nullptr;
+    std::size_t size_ = 0;
+    std::string path_;
+};
+
+// Merges sorted base records with changed ones (which win on equal keys) and
+// drops zero values, producing the record array of a compacted snapshot
+template <typename Record, typename Less>
+std::vector<Record> mergeSnapshotRecords(const Record* base, const Record* baseEnd, std::vector<Record> changes,
+                                         Less less) {
+    std::sort(changes.begin(), changes.end(), less);
+    std::vector<Record> merged;
+    merged.reserve(static_cast<std::size_t>(baseEnd - base) + changes.size());
+    auto keep = [&merged](const Record& record) {
+        if (!record.value.isZero()) merged.push_back(record);
+    };
+    auto change = changes.begin();
+    while (base != baseEnd || change != changes.end()) {
+        if (change == changes.end() || (base != baseEnd && less(*base, *change))) {
+            keep(*base++);
+        } else {
+            if (base != baseEnd && !less(*change, *base)) ++base;
+            keep(*change++);
+        }
+    }
+    return merged;
+}
+
+#endif  // VERSATUS_CPP_SNAPSHOT_HPP
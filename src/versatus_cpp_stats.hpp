@@ -0,0 +1,148 @@
+#ifndef VERSATUS_CPP_STATS_HPP
+#define VERSATUS_CPP_STATS_HPP
+
+/*
+    Per-phase instrumentation of the call path.
+
+    Define VERSATUS_STATS to enable it. Every call then accumulates the
+    time spent in each phase (decoding the inputs, finding the function,
+    running the token operation, committing the output) and counts ledger
+    map lookups and inserts, input bytes parsed and output bytes emitted.
+    process_erc20 writes one stats record per call to stderr and
+    process_erc20_batch one per batch, so stdout keeps carrying only results.
+
+    Phase timers are exclusive: a nested phase pauses the one around it, so
+    no time is counted twice. Stats are kept per thread.
+    Allocations are counted only where the program's replacement operator
+    new calls VERSATUS_STATS_COUNT(Allocations, 1), since a header cannot
+    replace it (main.cpp does so in stats builds).
+
+    Without VERSATUS_STATS every macro expands to nothing and its arguments
+    are not evaluated.
+*/
+
+#ifdef VERSATUS_STATS
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+enum class StatPhase : uint8_t {
+    Gather,
+    Dispatch,
+    Operation,
+    Commit,
+    None
+};
+
+enum class StatCounter : uint8_t {
+    MapLookups,
+    MapInserts,
+    BytesParsed,
+    BytesEmitted,
+    Allocations,
+    Count
+};
+
+struct CallStats {
+    static constexpr std::size_t kPhases = static_cast<std::size_t>(StatPhase::None);
+    static constexpr std::size_t kCounters = static_cast<std::size_t>(StatCounter::Count);
+
+    uint64_t calls = 0;
+    uint64_t phaseNs[kPhases] = {};
+    uint64_t counters[kCounters] = {};
+
+    // The phase being timed and when it was last started or resumed
+    StatPhase active = StatPhase::None;
+    std::chrono::steady_clock::time_point activeSince{};
+
+    void clear() {
+        calls = 0;
+        for (auto& ns : phaseNs) ns = 0;
+        for (auto& count : counters) count = 0;
+    }
+
+    // One compact JSON line, e.g. {"calls":1,"gatherNs":5100,...,"allocations":12}
+    void appendJson(std::string& out) const {
+        static constexpr const char* kPhaseKeys[kPhases] = {"gatherNs", "dispatchNs", "operationNs", "commitNs"};
+        static constexpr const char* kCounterKeys[kCounters] = {"mapLookups", "mapInserts", "bytesParsed",
+                                                                "bytesEmitted", "allocations"};
+        out += "{\"calls\":";
+        out += std::to_string(calls);
+        for (std::size_t i = 0; i < kPhases; ++i) _appendField(out, kPhaseKeys[i], phaseNs[i]);
+        for (std::size_t i = 0; i < kCounters; ++i) _appendField(out, kCounterKeys[i], counters[i]);
+        out += "}\n";
+    }
+
+    // Writes the record to stderr and starts counting afresh
+    void emit() {
+        std::string out;
+        appendJson(out);
+        std::fwrite(out.data(), 1, out.size(), stderr);
+        clear();
+    }
+
+private:
+    static void _appendField(std::string& out, const char* key, uint64_t value) {
+        out += ",\"";
+        out += key;
+        out += "\":";
+        out += std::to_string(value);
+    }
+};
+
+inline thread_local CallStats call_stats;
+
+// Charges the time until it goes out of scope to phase, pausing the enclosing phase meanwhile
+class StatPhaseTimer {
+public:
+    explicit StatPhaseTimer(StatPhase phase) : outer_(call_stats.active) {
+        _switchTo(phase);
+    }
+
+    ~StatPhaseTimer() {
+        _switchTo(outer_);
+    }
+
+    StatPhaseTimer(const StatPhaseTimer&) = delete;
+    StatPhaseTimer& operator=(const StatPhaseTimer&) = delete;
+
+private:
+    static void _switchTo(StatPhase phase) {
+        const auto now = std::chrono::steady_clock::now();
+        if (call_stats.active != StatPhase::None) {
+            call_stats.phaseNs[static_cast<std::size_t>(call_stats.active)] += static_cast<uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(now - call_stats.activeSince).count());
+        }
+        call_stats.active = phase;
+        call_stats.activeSince = now;
+    }
+
+    StatPhase outer_;
+};
+
+#define VERSATUS_STATS_CONCAT_(a, b) a##b
+#define VERSATUS_STATS_CONCAT(a, b) VERSATUS_STATS_CONCAT_(a, b)
+
+// Times the rest of the enclosing scope as StatPhase::phase
+#define VERSATUS_STATS_PHASE(phase) \
+    StatPhaseTimer VERSATUS_STATS_CONCAT(statPhaseTimer_, __LINE__)(StatPhase::phase)
+// Adds n to StatCounter::counter
+#define VERSATUS_STATS_COUNT(counter, n) \
+    (call_stats.counters[static_cast<std::size_t>(StatCounter::counter)] += static_cast<uint64_t>(n))
+// Counts one call (or, with n, several) towards the next record
+#define VERSATUS_STATS_CALLS(n) (call_stats.calls += static_cast<uint64_t>(n))
+#define VERSATUS_STATS_EMIT() call_stats.emit()
+
+#else
+
+#define VERSATUS_STATS_PHASE(phase) static_cast<void>(0)
+#define VERSATUS_STATS_COUNT(counter, n) static_cast<void>(0)
+#define VERSATUS_STATS_CALLS(n) static_cast<void>(0)
+#define VERSATUS_STATS_EMIT() static_cast<void>(0)
+
+#endif  // VERSATUS_STATS
+
+#endif  // VERSATUS_CPP_STATS_HPP
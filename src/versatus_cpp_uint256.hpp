@@ -0,0 +1,365 @@
+#ifndef VERSATUS_CPP_UINT256_HPP
+#define VERSATUS_CPP_UINT256_HPP
+
+/*
+    Fixed-width 256-bit unsigned integer stored as four little-endian 64-bit limbs.
+
+    Arithmetic wraps modulo 2^256 like boost::multiprecision::uint256_t, so it
+    can stand in for that type; addOverflow/subOverflow/mulOverflow report the
+    carry for callers that must not wrap. The type is trivially copyable and
+    needs no allocation, which keeps it cheap to pass around natively and in WASM.
+*/
+
+#include <array>
+#include <bit>
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+class Uint256 {
+public:
+    static constexpr std::size_t kLimbs = 4;
+
+    constexpr Uint256() : limbs_{0, 0, 0, 0} {}
+
+    // Any integer converts implicitly; negative values wrap modulo 2^256
+    template <typename T, std::enable_if_t<std::is_integral_v<T>, int> = 0>
+    constexpr Uint256(T value) {
+        const uint64_t fill = (std::is_signed_v<T> && value < 0) ? ~0ull : 0;
+        limbs_ = {static_cast<uint64_t>(value), fill, fill, fill};
+    }
+
+    // Parses "0x"-prefixed hex or decimal text; throws std::invalid_argument on
+    // malformed input. Values wider than 256 bits wrap, as with boost.
+    explicit Uint256(std::string_view text) {
+        if (!parse(text, *this, /*allowWrap=*/true)) {
+            throw std::invalid_argument("Invalid uint256 string: " + std::string(text));
+        }
+    }
+    explicit Uint256(const std::string& text) : Uint256(std::string_view(text)) {}
+    explicit Uint256(const char* text) : Uint256(std::string_view(text)) {}
+
+    static constexpr Uint256 fromLimbs(uint64_t l0, uint64_t l1, uint64_t l2, uint64_t l3) {
+        Uint256 result;
+        result.limbs_ = {l0, l1, l2, l3};
+        return result;
+    }
+
+    static constexpr Uint256 max() {
+        return fromLimbs(~0ull, ~0ull, ~0ull, ~0ull);
+    }
+
+    // Strict parse: rejects malformed text and values that do not fit in 256 bits
+    static bool fromString(std::string_view text, Uint256& out) {
+        return parse(text, out, /*allowWrap=*/false);
+    }
+
+    constexpr uint64_t limb(std::size_t i) const {
+        return limbs_[i];
+    }
+
+    constexpr bool isZero() const {
+        return (limbs_[0] | limbs_[1] | limbs_[2] | limbs_[3]) == 0;
+    }
+
+    constexpr explicit operator bool() const {
+        return !isZero();
+    }
+
+    // Low 64 bits, like boost's convert_to<uint64_t>() on a value that fits
+    constexpr uint64_t low64() const {
+        return limbs_[0];
+    }
+
+    // Comparison
+    friend constexpr bool operator==(const Uint256& a, const Uint256& b) {
+        return a.limbs_[0] == b.limbs_[0] && a.limbs_[1] == b.limbs_[1] &&
+               a.limbs_[2] == b.limbs_[2] && a.limbs_[3] == b.limbs_[3];
+    }
+
+    friend constexpr std::strong_ordering operator<=>(const Uint256& a, const Uint256& b) {
+        for (std::size_t i = kLimbs; i-- > 0;) {
+            if (a.limbs_[i] != b.limbs_[i]) {
+                return a.limbs_[i] < b.limbs_[i] ? std::strong_ordering::less : std::strong_ordering::greater;
+            }
+        }
+        return std::strong_ordering::equal;
+    }
+
+    // Ordered comparisons as a branch-free borrow chain
+    friend constexpr bool operator<(const Uint256& a, const Uint256& b) {
+        return lessThan(a, b);
+    }
+
+    friend constexpr bool operator>(const Uint256& a, const Uint256& b) {
+        return lessThan(b, a);
+    }
+
+    friend constexpr bool operator<=(const Uint256& a, const Uint256& b) {
+        return !lessThan(b, a);
+    }
+
+    friend constexpr bool operator>=(const Uint256& a, const Uint256& b) {
+        return !lessThan(a, b);
+    }
+
+    // Checked arithmetic: write the wrapped result to `out`, return true on overflow
+    friend constexpr bool addOverflow(const Uint256& a, const Uint256& b, Uint256& out) {
+        uint64_t carry = 0;
+        for (std::size_t i = 0; i < kLimbs; ++i) {
+            uint64_t sum = a.limbs_[i] + carry;
+            uint64_t c1 = (sum < carry);
+            uint64_t total = sum + b.limbs_[i];
+            carry = c1 | (total < sum);
+            out.limbs_[i] = total;
+        }
+        return carry != 0;
+    }
+
+    friend constexpr bool subOverflow(const Uint256& a, const Uint256& b, Uint256& out) {
+        uint64_t borrow = 0;
+        for (std::size_t i = 0; i < kLimbs; ++i) {
+            uint64_t diff = a.limbs_[i] - borrow;
+            uint64_t b1 = (a.limbs_[i] < borrow);
+            uint64_t total = diff - b.limbs_[i];
+            borrow = b1 | (diff < b.limbs_[i]);
+            out.limbs_[i] = total;
+        }
+        return borrow != 0;
+    }
+
+    friend constexpr bool mulOverflow(const Uint256& a, const Uint256& b, Uint256& out) {
+        uint64_t result[kLimbs] = {0, 0, 0, 0};
+        bool overflow = false;
+        for (std::size_t i = 0; i < kLimbs; ++i) {
+            if (a.limbs_[i] == 0) continue;
+            uint64_t carry = 0;
+            for (std::size_t j = 0; j < kLimbs; ++j) {
+                if (i + j >= kLimbs) {
+                    overflow |= (b.limbs_[j] != 0);
+                    continue;
+                }
+                uint64_t hi = 0;
+                uint64_t lo = mulWide(a.limbs_[i], b.limbs_[j], hi);
+                lo += carry;
+                hi += (lo < carry);
+                result[i + j] += lo;
+                hi += (result[i + j] < lo);
+                carry = hi;
+            }
+            overflow |= (carry != 0);
+        }
+        out.limbs_ = {result[0], result[1], result[2], result[3]};
+        return overflow;
+    }
+
+    // Wrapping arithmetic
+    friend constexpr Uint256 operator+(const Uint256& a, const Uint256& b) {
+        Uint256 out;
+        addOverflow(a, b, out);
+        return out;
+    }
+
+    friend constexpr Uint256 operator-(const Uint256& a, const Uint256& b) {
+        Uint256 out;
+        subOverflow(a, b, out);
+        return out;
+    }
+
+    friend constexpr Uint256 operator*(const Uint256& a, const Uint256& b) {
+        Uint256 out;
+        mulOverflow(a, b, out);
+        return out;
+    }
+
+    constexpr Uint256& operator+=(const Uint256& other) {
+        addOverflow(*this, other, *this);
+        return *this;
+    }
+
+    constexpr Uint256& operator-=(const Uint256& other) {
+        subOverflow(*this, other, *this);
+        return *this;
+    }
+
+    constexpr Uint256& operator*=(const Uint256& other) {
+        mulOverflow(*this, other, *this);
+        return *this;
+    }
+
+    // Divides in place by a 64-bit divisor and returns the remainder
+    constexpr uint64_t divmodSmall(uint64_t divisor) {
+        uint64_t remainder = 0;
+        for (std::size_t i = kLimbs; i-- > 0;) {
+            limbs_[i] = div128by64(remainder, limbs_[i], divisor, remainder);
+        }
+        return remainder;
+    }
+
+    // Number of significant bits (0 for zero)
+    constexpr unsigned bitWidth() const {
+        for (std::size_t i = kLimbs; i-- > 0;) {
+            if (limbs_[i] != 0) return static_cast<unsigned>(i * 64 + 64 - std::countl_zero(limbs_[i]));
+        }
+        return 0;
+    }
+
+    // Decimal text, matching boost's str()
+    std::string str() const {
+        if (isZero()) return "0";
+        // 10^19 is the largest power of ten that fits a limb
+        constexpr uint64_t kChunk = 10000000000000000000ull;
+        char buffer[80];
+        std::size_t pos = sizeof(buffer);
+        Uint256 value = *this;
+        while (!value.isZero()) {
+            uint64_t chunk = value.divmodSmall(kChunk);
+            for (int digit = 0; digit < 19; ++digit) {
+                buffer[--pos] = static_cast<char>('0' + chunk % 10);
+                chunk /= 10;
+                if (value.isZero() && chunk == 0) break;
+            }
+        }
+        return std::string(buffer + pos, sizeof(buffer) - pos);
+    }
+
+    // Lowercase hex without prefix or leading zeros
+    std::string toHex(bool uppercase = false) const {
+        const char* digits = uppercase ? "0123456789ABCDEF" : "0123456789abcdef";
+        unsigned nibbles = (bitWidth() + 3) / 4;
+        if (nibbles == 0) return "0";
+        std::string out(nibbles, '0');
+        for (unsigned i = 0; i < nibbles; ++i) {
+            out[nibbles - 1 - i] = digits[(limbs_[i / 16] >> ((i % 16) * 4)) & 0xf];
+        }
+        return out;
+    }
+
+    // Honors std::hex / std::uppercase / std::showbase like the boost type
+    friend std::ostream& operator<<(std::ostream& os, const Uint256& value) {
+        auto flags = os.flags();
+        if (flags & std::ios_base::hex) {
+            if (flags & std::ios_base::showbase) os << ((flags & std::ios_base::uppercase) ? "0X" : "0x");
+            return os << value.toHex(flags & std::ios_base::uppercase);
+        }
+        return os << value.str();
+    }
+
+private:
+    static constexpr bool lessThan(const Uint256& a, const Uint256& b) {
+        uint64_t borrow = 0;
+        for (std::size_t i = 0; i < kLimbs; ++i) {
+            uint64_t diff = a.limbs_[i] - borrow;
+            borrow = (a.limbs_[i] < borrow) | (diff < b.limbs_[i]);
+        }
+        return borrow != 0;
+    }
+
+    // this = this * mul + add; returns true if the result wrapped
+    constexpr bool mulAddSmall(uint64_t mul, uint64_t add) {
+        uint64_t carry = add;
+        for (std::size_t i = 0; i < kLimbs; ++i) {
+            uint64_t hi = 0;
+            uint64_t lo = mulWide(limbs_[i], mul, hi);
+            lo += carry;
+            hi += (lo < carry);
+            limbs_[i] = lo;
+            carry = hi;
+        }
+        return carry != 0;
+    }
+
+    // Full 64x64 -> 128 multiply: returns the low half, writes the high half
+    static constexpr uint64_t mulWide(uint64_t a, uint64_t b, uint64_t& hi) {
+#if defined(__SIZEOF_INT128__)
+        unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+        hi = static_cast<uint64_t>(product >> 64);
+        return static_cast<uint64_t>(product);
+#else
+        uint64_t aLo = a & 0xffffffff, aHi = a >> 32;
+        uint64_t bLo = b & 0xffffffff, bHi = b >> 32;
+        uint64_t lo = aLo * bLo, mid1 = aHi * bLo, mid2 = aLo * bHi;
+        uint64_t cross = (lo >> 32) + (mid1 & 0xffffffff) + mid2;
+        hi = aHi * bHi + (mid1 >> 32) + (cross >> 32);
+        return (cross << 32) | (lo & 0xffffffff);
+#endif
+    }
+
+    // (hi:lo) / divisor with hi < divisor; writes the remainder
+    static constexpr uint64_t div128by64(uint64_t hi, uint64_t lo, uint64_t divisor, uint64_t& remainder) {
+#if defined(__SIZEOF_INT128__)
+        unsigned __int128 dividend = (static_cast<unsigned __int128>(hi) << 64) | lo;
+        remainder = static_cast<uint64_t>(dividend % divisor);
+        return static_cast<uint64_t>(dividend / divisor);
+#else
+        // Restoring shift-subtract division, one bit at a time
+        uint64_t quotient = 0;
+        for (int i = 63; i >= 0; --i) {
+            bool carry = (hi >> 63) != 0;
+            hi = (hi << 1) | ((lo >> i) & 1);
+            quotient <<= 1;
+            if (carry || hi >= divisor) {
+                hi -= divisor;
+                quotient |= 1;
+            }
+        }
+        remainder = hi;
+        return quotient;
+#endif
+    }
+
+    static constexpr int hexDigit(char c) {
+        if (c >= '0' && c <= '9') return c - '0';
+        if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+        if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+        return -1;
+    }
+
+    static bool parse(std::string_view text, Uint256& out, bool allowWrap) {
+        Uint256 value;
+        bool overflow = false;
+        if (text.size() >= 2 && text[0] == '0' && (text[1] == 'x' || text[1] == 'X')) {
+            text.remove_prefix(2);
+            if (text.empty()) return false;
+            for (char c : text) {
+                int digit = hexDigit(c);
+                if (digit < 0) return false;
+                overflow |= (value.limbs_[3] >> 60) != 0;
+                value.limbs_[3] = (value.limbs_[3] << 4) | (value.limbs_[2] >> 60);
+                value.limbs_[2] = (value.limbs_[2] << 4) | (value.limbs_[1] >> 60);
+                value.limbs_[1] = (value.limbs_[1] << 4) | (value.limbs_[0] >> 60);
+                value.limbs_[0] = (value.limbs_[0] << 4) | static_cast<uint64_t>(digit);
+            }
+        } else {
+            if (text.empty()) return false;
+            // Accumulate up to 19 digits in a limb, then fold them in with one multiply-add
+            while (!text.empty()) {
+                std::size_t len = text.size() < 19 ? text.size() : 19;
+                uint64_t chunk = 0, scale = 1;
+                for (std::size_t i = 0; i < len; ++i) {
+                    char c = text[i];
+                    if (c < '0' || c > '9') return false;
+                    chunk = chunk * 10 + static_cast<uint64_t>(c - '0');
+                    scale *= 10;
+                }
+                overflow |= value.mulAddSmall(scale, chunk);
+                text.remove_prefix(len);
+            }
+        }
+        if (overflow && !allowWrap) return false;
+        out = value;
+        return true;
+    }
+
+    std::array<uint64_t, kLimbs> limbs_;
+};
+
+static_assert(std::is_trivially_copyable_v<Uint256>, "Uint256 must stay trivially copyable");
+static_assert(sizeof(Uint256) == 32, "Uint256 must be exactly 256 bits");
+
+#endif  // VERSATUS_CPP_UINT256_HPP
@@ -0,0 +1,172 @@
+#ifndef VERSATUS_CPP_WIRE_HPP
+#define VERSATUS_CPP_WIRE_HPP
+
+/*
+    Primitives for the compact binary wire format.
+
+    Integers are fixed-width little-endian, uint256 values are 32 bytes
+    big-endian (the same byte order as their hex text), byte arrays are raw,
+    and strings are a u32 length followed by their bytes. Message layouts are
+    defined by the to_wire/from_wire methods next to each to_json/from_json.
+*/
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+#include "./versatus_cpp_uint256.hpp"
+
+// Leading bytes that tell a binary message apart from JSON text
+constexpr char WIRE_INPUT_MAGIC[4] = {'V', 'R', 'S', 'I'};
+constexpr char WIRE_OUTPUT_MAGIC[4] = {'V', 'R', 'S', 'O'};
+// Header of a batch stream of u32 length-prefixed binary messages
+constexpr char WIRE_BATCH_MAGIC[4] = {'V', 'R', 'S', 'B'};
+// Version 2 added the ERC721 function inputs, results and events, version 3 the
+// ERC20 transferBatch input and result
+constexpr uint8_t WIRE_FORMAT_VERSION = 3;
+
+enum class WireFormat : uint8_t {
+    Json,
+    Binary
+};
+
+inline bool hasWireMagic(std::string_view data, const char (&magic)[4]) {
+    return data.size() >= sizeof(magic) && std::memcmp(data.data(), magic, sizeof(magic)) == 0;
+}
+
+class WireWriter {
+public:
+    explicit WireWriter(std::string& out) : out_(out) {}
+
+    void writeBytes(const void* data, std::size_t size) {
+        out_.append(static_cast<const char*>(data), size);
+    }
+
+    void writeU8(uint8_t value) {
+        out_.push_back(static_cast<char>(value));
+    }
+
+    void writeU32(uint32_t value) {
+        writeLittleEndian(value);
+    }
+
+    void writeU64(uint64_t value) {
+        writeLittleEndian(value);
+    }
+
+    void writeI32(int32_t value) {
+        writeLittleEndian(static_cast<uint32_t>(value));
+    }
+
+    void writeString(std::string_view value) {
+        writeU32(static_cast<uint32_t>(value.size()));
+        writeBytes(value.data(), value.size());
+    }
+
+    template <std::size_t N>
+    void writeArray(const std::array<uint8_t, N>& value) {
+        writeBytes(value.data(), N);
+    }
+
+    void writeUint256(const Uint256& value) {
+        for (std::size_t i = Uint256::kLimbs; i-- > 0;) {
+            uint64_t limb = value.limb(i);
+            for (int shift = 56; shift >= 0; shift -= 8) writeU8(static_cast<uint8_t>(limb >> shift));
+        }
+    }
+
+private:
+    template <typename T>
+    void writeLittleEndian(T value) {
+        for (std::size_t i = 0; i < sizeof(T); ++i) writeU8(static_cast<uint8_t>(value >> (8 * i)));
+    }
+
+    std::string& out_;
+};
+
+// Bounds-checked cursor over a binary message; throws std::runtime_error when truncated
+class WireReader {
+public:
+    explicit WireReader(std::string_view data) : data_(data) {}
+
+    std::size_t remaining() const {
+        return data_.size() - pos_;
+    }
+
+    const char* readBytes(std::size_t size) {
+        if (size > remaining()) throw std::runtime_error("Wire message truncated");
+        const char* start = data_.data() + pos_;
+        pos_ += size;
+        return start;
+    }
+
+    uint8_t readU8() {
+        return static_cast<uint8_t>(*readBytes(1));
+    }
+
+    uint32_t readU32() {
+        return readLittleEndian<uint32_t>();
+    }
+
+    uint64_t readU64() {
+        return readLittleEndian<uint64_t>();
+    }
+
+    // Element count of an array whose elements take at least elementSize
+    // bytes each; a count the rest of the message cannot hold is rejected
+    // before the caller allocates for it
+    uint32_t readCount(std::size_t elementSize) {
+        const uint32_t count = readU32();
+        if (count > remaining() / elementSize) throw std::runtime_error("Wire message truncated");
+        return count;
+    }
+
+    int32_t readI32() {
+        return static_cast<int32_t>(readLittleEndian<uint32_t>());
+    }
+
+    std::string readString() {
+        uint32_t size = readU32();
+        const char* bytes = readBytes(size);
+        return std::string(bytes, size);
+    }
+
+    template <std::size_t N>
+    void readArray(std::array<uint8_t, N>& value) {
+        std::memcpy(value.data(), readBytes(N), N);
+    }
+
+    Uint256 readUint256() {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(readBytes(32));
+        uint64_t limbs[Uint256::kLimbs] = {0, 0, 0, 0};
+        for (std::size_t i = 0; i < 32; ++i) {
+            limbs[Uint256::kLimbs - 1 - i / 8] = (limbs[Uint256::kLimbs - 1 - i / 8] << 8) | bytes[i];
+        }
+        return Uint256::fromLimbs(limbs[0], limbs[1], limbs[2], limbs[3]);
+    }
+
+    void expectMagic(const char (&magic)[4], uint8_t version = WIRE_FORMAT_VERSION) {
+        if (std::memcmp(readBytes(sizeof(magic)), magic, sizeof(magic)) != 0) {
+            throw std::runtime_error("Wire message has the wrong magic header");
+        }
+        if (readU8() != version) throw std::runtime_error("Unsupported wire format version");
+    }
+
+private:
+    template <typename T>
+    T readLittleEndian() {
+        const uint8_t* bytes = reinterpret_cast<const uint8_t*>(readBytes(sizeof(T)));
+        T value = 0;
+        for (std::size_t i = 0; i < sizeof(T); ++i) value |= static_cast<T>(bytes[i]) << (8 * i);
+        return value;
+    }
+
+    std::string_view data_;
+    std::size_t pos_ = 0;
+};
+
+#endif  // VERSATUS_CPP_WIRE_HPP